@@ -0,0 +1,185 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <condition_variable>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "util.hpp"
+#include "compress.hpp"
+
+// 滚动文件的归档：文件切换后由低优先级后台线程压缩，再按数量、总大小、时间清理旧文件
+namespace logsys
+{
+    struct ArchiveOption
+    {
+        CompressType _compress = CompressType::NONE; // 未链接zstd时ZSTD退化为GZIP
+        int _level = -1;                             // 压缩等级，小于0表示默认等级
+        size_t _max_files = 0;                       // 最多保留的已归档文件数，0表示不限制
+        size_t _max_bytes = 0;                       // 已归档文件的总大小上限，0表示不限制
+        size_t _max_age = 0;                         // 已归档文件的最长保留时间（秒），0表示不限制
+    };
+
+    class Archiver
+    {
+    public:
+        using ptr = std::shared_ptr<Archiver>;
+
+    public:
+        // basename为滚动文件名的公共前缀，清理时只处理符合滚动命名规则的文件：
+        // basename + 14位时间戳（%Y%m%d%H%M%S）+ 序号（sequenced为true时为"-N"）+ 可选的压缩后缀
+        Archiver(const std::string &basename, const ArchiveOption &option, bool sequenced = true)
+            : _basename(basename),
+              _option(option),
+              _sequenced(sequenced),
+              _running(true),
+              _worker(&Archiver::loop, this)
+        {
+        }
+        // 等待已提交的文件处理完毕
+        ~Archiver()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _running = false;
+            }
+            _cond.notify_all();
+            _worker.join();
+        }
+        // 文件已关闭，不会再写入；active为当前正在写入的文件，清理时跳过
+        void push(const std::string &filename, const std::string &active)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _tasks.push_back(filename);
+                _active = active;
+            }
+            _cond.notify_one();
+        }
+
+    private:
+        void loop()
+        {
+            lowerPriority();
+            std::unique_lock<std::mutex> lock(_mtx);
+            while (true)
+            {
+                _cond.wait(lock, [&](){return !_running || !_tasks.empty();});
+                if (_tasks.empty()) return;
+                std::string filename = std::move(_tasks.front());
+                _tasks.pop_front();
+                std::string active = _active;
+                lock.unlock();
+                compress(filename);
+                retain(active);
+                lock.lock();
+            }
+        }
+        // CPU与IO优先级都降到最低，避免与日志写入争抢资源
+        static void lowerPriority()
+        {
+#ifdef __linux__
+            pid_t tid = syscall(SYS_gettid);
+            setpriority(PRIO_PROCESS, tid, 19);
+#ifdef SYS_ioprio_set
+            const int IOPRIO_WHO_PROCESS = 1, IOPRIO_CLASS_IDLE = 3, IOPRIO_CLASS_SHIFT = 13;
+            syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+#endif
+#endif
+        }
+        // 先写入临时文件再改名，压缩中途退出不会留下不完整的归档文件
+        void compress(const std::string &filename)
+        {
+            if (_option._compress == CompressType::NONE) return;
+            std::string dst = filename + compressSuffix(availableCompress(_option._compress));
+            std::string tmp = dst + ".tmp";
+            std::error_code ec;
+            if (compressFile(filename, tmp, _option._compress, _option._level))
+            {
+                fs::rename(tmp, dst, ec);
+                if (!ec) fs::remove(filename, ec);
+            }
+            else fs::remove(tmp, ec);
+        }
+        // 从最旧的文件开始删除，直到满足所有限制
+        void retain(const std::string &active)
+        {
+            if (!_option._max_files && !_option._max_bytes && !_option._max_age) return;
+            struct Entry
+            {
+                fs::path _path;
+                fs::file_time_type _time;
+                size_t _size;
+            };
+            std::vector<Entry> entries;
+            std::error_code ec;
+            fs::path base(_basename);
+            fs::path dir = base.has_parent_path() ? base.parent_path() : fs::path(".");
+            std::string prefix = base.filename().string();
+            for (auto &entry : fs::directory_iterator(dir, ec))
+            {
+                std::string name = entry.path().filename().string();
+                if (!isRolled(name, prefix) || entry.path() == fs::path(active)) continue;
+                if (!entry.is_regular_file(ec)) continue;
+                entries.push_back({entry.path(), entry.last_write_time(ec), (size_t)entry.file_size(ec)});
+            }
+            std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b){ return a._time < b._time; });
+            size_t total = 0;
+            for (auto &entry : entries) total += entry._size;
+            auto now = fs::file_time_type::clock::now();
+            size_t count = entries.size();
+            for (auto &entry : entries)
+            {
+                bool expired = _option._max_age && now - entry._time > std::chrono::seconds(_option._max_age);
+                if (!expired && (!_option._max_files || count <= _option._max_files) &&
+                    (!_option._max_bytes || total <= _option._max_bytes))
+                    break;
+                fs::remove(entry._path, ec);
+                --count;
+                total -= entry._size;
+            }
+        }
+
+        // 是否为本滚动方式产生的文件，同名前缀的其他文件（如固定文件、索引文件）不能被清理
+        bool isRolled(std::string_view name, std::string_view prefix) const
+        {
+            const size_t TIMESTAMP_LEN = 14;
+            auto digits = [](std::string_view str) {
+                return !str.empty() && std::all_of(str.begin(), str.end(), [](char c){ return c >= '0' && c <= '9'; });
+            };
+            if (!name.starts_with(prefix)) return false;
+            name.remove_prefix(prefix.size());
+            for (CompressType type : {CompressType::GZIP, CompressType::ZSTD})
+            {
+                std::string_view suffix = compressSuffix(type);
+                if (name.ends_with(suffix))
+                {
+                    name.remove_suffix(suffix.size());
+                    break;
+                }
+            }
+            if (name.size() < TIMESTAMP_LEN || !digits(name.substr(0, TIMESTAMP_LEN))) return false;
+            name.remove_prefix(TIMESTAMP_LEN);
+            if (!_sequenced) return name.empty();
+            return name.starts_with('-') && digits(name.substr(1));
+        }
+
+    private:
+        std::string _basename;
+        ArchiveOption _option;
+        bool _sequenced; // 滚动文件名是否带"-N"序号
+        bool _running;
+        std::mutex _mtx;
+        std::condition_variable _cond;
+        std::deque<std::string> _tasks;
+        std::string _active;
+        std::thread _worker; // 必须最后初始化
+    };
+};
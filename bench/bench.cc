@@ -0,0 +1,244 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include "logger.hpp"
+using namespace std;
+
+// 日志器基准测试：吞吐量、单次调用延迟分位数、生产者线程数扩展性
+// 每个测试用例输出一行JSON，便于跨版本追踪性能回归
+// 用法：bench [--loggers=sync,async,ring,staged,deferred] [--sinks=null,stdout,fixed,mmap,uring,gzip,roll_size,roll_time]
+//            [--threads=1,2,4,8] [--payloads=64,512] [--patterns=default,minimal] [--messages=200000]
+//            [--syncs=none,flush,bytes,interval,every] [--dir=./bench_logs]
+// 日志文件写在--dir下新建的临时子目录中，结束时只删除该子目录
+
+struct Options
+{
+    vector<string> loggers{"sync", "async", "ring", "staged", "deferred"};
+    vector<string> sinks{"null", "fixed"};
+    vector<size_t> threads;
+    vector<size_t> payloads{64, 512};
+    vector<string> patterns{"default"};
+    vector<string> syncs{"none"};
+    size_t messages = 200000; // 每个用例的总条数，平均分给各个线程
+    string dir = "./bench_logs";
+};
+
+// 统计写入字节数后转交给真正的落地方向
+class CountingSink : public logsys::LogSink
+{
+public:
+    CountingSink(const logsys::LogSink::ptr &sink, atomic<size_t> &bytes) : _sink(sink), _bytes(bytes) {}
+    void log(const char *data, size_t len) override
+    {
+        _bytes.fetch_add(len, memory_order_relaxed);
+        _sink->log(data, len);
+    }
+    void logBatch(const logsys::Fragment *frags, size_t n) override
+    {
+        for (size_t i = 0; i < n; ++i) _bytes.fetch_add(frags[i]._len, memory_order_relaxed);
+        _sink->logBatch(frags, n);
+    }
+    void flush() override { _sink->flush(); }
+    void sync() override { _sink->sync(); }
+private:
+    logsys::LogSink::ptr _sink;
+    atomic<size_t> &_bytes;
+};
+
+static vector<string> split(const string &str)
+{
+    vector<string> ret;
+    size_t begin = 0;
+    while (begin <= str.size())
+    {
+        size_t pos = str.find(',', begin);
+        if (pos == string::npos) pos = str.size();
+        if (pos > begin) ret.push_back(str.substr(begin, pos - begin));
+        begin = pos + 1;
+    }
+    return ret;
+}
+
+static Options parseOptions(int argc, char *argv[])
+{
+    Options opt;
+    size_t hw = max(1u, thread::hardware_concurrency());
+    for (size_t n = 1; n < hw; n <<= 1) opt.threads.push_back(n);
+    opt.threads.push_back(hw);
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == string::npos)
+            throw runtime_error("invalid argument: " + arg);
+        string key = arg.substr(2, eq - 2), value = arg.substr(eq + 1);
+        if (key == "loggers") opt.loggers = split(value);
+        else if (key == "sinks") opt.sinks = split(value);
+        else if (key == "patterns") opt.patterns = split(value);
+        else if (key == "syncs") opt.syncs = split(value);
+        else if (key == "messages") opt.messages = stoul(value);
+        else if (key == "dir") opt.dir = value;
+        else if (key == "threads" || key == "payloads")
+        {
+            vector<size_t> v;
+            for (auto &s : split(value)) v.push_back(stoul(s));
+            (key == "threads" ? opt.threads : opt.payloads) = v;
+        }
+        else throw runtime_error("unknown option: " + key);
+    }
+    return opt;
+}
+
+static logsys::LogSink::ptr createSink(const string &name, const string &dir)
+{
+    if (name == "null") return logsys::sinkCreate<logsys::NullLogSink>();
+    if (name == "stdout") return logsys::sinkCreate<logsys::StdOutLogSink>();
+    if (name == "fixed") return logsys::sinkCreate<logsys::FixedFileLogSink>(dir + "/fixed.log");
+    if (name == "uring") return logsys::sinkCreate<logsys::UringFileLogSink>(dir + "/uring.log");
+    if (name == "gzip") return logsys::sinkCreate<logsys::CompressedFileLogSink>(dir + "/gzip.log");
+    if (name == "mmap") return logsys::sinkCreate<logsys::MmapFileLogSink>(dir + "/mmap.log");
+    if (name == "roll_size") return logsys::sinkCreate<logsys::RollBySizeLogSink>(dir + "/roll_size.log", 64 * 1024 * 1024);
+    if (name == "roll_time") return logsys::sinkCreate<logsys::RollByTimeLogSink>(dir + "/roll_time.log", logsys::gaptype::Minute);
+    throw runtime_error("unknown sink: " + name);
+}
+
+// 持久化策略：每批刷新、每4MB同步、每100毫秒同步、每批同步
+static logsys::SyncOption createSync(const string &name)
+{
+    logsys::SyncOption option;
+    if (name == "flush") option._flush = true;
+    else if (name == "bytes") option._bytes = 4 * 1024 * 1024;
+    else if (name == "interval") option._interval = 100;
+    else if (name == "every") option._level = logsys::Level::DEBUG;
+    else if (name != "none") throw runtime_error("unknown sync: " + name);
+    return option;
+}
+
+static logsys::Logger::ptr createLogger(const string &name, const string &pattern, const logsys::LogSink::ptr &sink,
+                                     const logsys::SyncOption &sync, atomic<size_t> &bytes)
+{
+    logsys::LocalLoggerBuilder builder;
+    builder.buildLoggerName("bench");
+    builder.buildType(name == "sync" ? logsys::LoggerType::LOGGER_SYNC : logsys::LoggerType::LOGGER_ASYNC);
+    if (name == "ring") builder.buildLooperType(logsys::LooperType::LOOPER_RING);
+    else if (name == "staged") builder.buildStaging();
+    else if (name == "deferred") builder.buildDeferredFormat();
+    else if (name != "sync" && name != "async") throw runtime_error("unknown logger: " + name);
+    if (pattern == "default") builder.buildFormat("[%d{%H:%M:%S.%6N}][%t][%p][%c][%f:%l] %m%n");
+    else if (pattern == "minimal") builder.buildFormat("%m%n");
+    else builder.buildFormat(pattern);
+    auto counting = logsys::sinkCreate<CountingSink>(sink, bytes);
+    counting->setSync(sync);
+    builder.buildSink(counting);
+    return builder.build();
+}
+
+static int64_t percentile(const vector<int64_t> &sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    size_t idx = min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[idx];
+}
+
+static void runCase(FILE *out, const Options &opt, const string &logger_name, const string &sink_name,
+                    size_t threads, size_t payload_size, const string &pattern, const string &sync,
+                    const string &dir)
+{
+    //dir是本程序创建的临时目录，每个用例开始前清空其中的文件
+    for (auto &entry : fs::directory_iterator(dir)) fs::remove_all(entry.path());
+    atomic<size_t> bytes(0);
+    size_t per_thread = max<size_t>(1, opt.messages / threads);
+    string payload(payload_size, 'x');
+    vector<vector<int64_t>> latency(threads, vector<int64_t>(per_thread));
+    double seconds;
+    {
+        auto logger = createLogger(logger_name, pattern, createSink(sink_name, dir), createSync(sync), bytes);
+        atomic<size_t> ready(0);
+        atomic<bool> go(false);
+        vector<thread> producers;
+        for (size_t t = 0; t < threads; ++t)
+        {
+            producers.emplace_back([&, t]() {
+                auto &lat = latency[t];
+                ++ready;
+                while (!go.load()) this_thread::yield();
+                for (size_t i = 0; i < per_thread; ++i)
+                {
+                    auto begin = chrono::steady_clock::now();
+                    LOG_INFO(logger, "{} {}", i, payload);
+                    lat[i] = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count();
+                }
+            });
+        }
+        while (ready.load() != threads) this_thread::yield();
+        auto begin = chrono::steady_clock::now();
+        go = true;
+        for (auto &producer : producers) producer.join();
+        //异步日志器需等到数据全部落地才算完成
+        logger->flush();
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    }
+    vector<int64_t> all;
+    all.reserve(threads * per_thread);
+    for (auto &lat : latency) all.insert(all.end(), lat.begin(), lat.end());
+    sort(all.begin(), all.end());
+    size_t total = threads * per_thread;
+    fprintf(out,
+            "{\"logger\":\"%s\",\"sink\":\"%s\",\"sync\":\"%s\",\"threads\":%zu,\"payload\":%zu,\"pattern\":\"%s\","
+            "\"messages\":%zu,\"seconds\":%.6f,\"msgs_per_sec\":%.0f,\"bytes_per_sec\":%.0f,"
+            "\"latency_ns\":{\"p50\":%lld,\"p99\":%lld,\"p999\":%lld,\"max\":%lld}}\n",
+            logger_name.c_str(), sink_name.c_str(), sync.c_str(), threads, payload_size, pattern.c_str(), total, seconds,
+            total / seconds, bytes.load() / seconds, (long long)percentile(all, 0.5), (long long)percentile(all, 0.99),
+            (long long)percentile(all, 0.999), (long long)all.back());
+    fflush(out);
+}
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    try
+    {
+        opt = parseOptions(argc, argv);
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    string dir;
+    try
+    {
+        fs::create_directories(opt.dir);
+        string tmpl = opt.dir + "/bench.XXXXXX";
+        if (mkdtemp(tmpl.data()) == nullptr) throw runtime_error("无法在" + opt.dir + "下创建临时目录");
+        dir = tmpl;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    //结果写到原标准输出，标准输出落地方向被重定向到/dev/null
+    FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+    for (auto &sync : opt.syncs)
+        for (auto &pattern : opt.patterns)
+            for (auto &sink : opt.sinks)
+                for (auto &logger : opt.loggers)
+                    for (auto payload : opt.payloads)
+                        for (auto threads : opt.threads)
+                            runCase(out, opt, logger, sink, threads, payload, pattern, sync, dir);
+    fs::remove_all(dir);
+    fclose(out);
+    return 0;
+}
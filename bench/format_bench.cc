@@ -0,0 +1,92 @@
+#include <iostream>
+#include <chrono>
+#include <sstream>
+#include "format.hpp"
+#include "static_format.hpp"
+using namespace std;
+
+// 旧版本的格式化路径：每个格式化子项写入std::ostream，每条日志新建一个std::stringstream再拷贝出结果
+namespace legacy
+{
+    struct Item
+    {
+        char _key;
+        string _value;
+    };
+    class StreamFormat
+    {
+    public:
+        StreamFormat(const vector<Item> &items) : _items(items) {}
+        string format(const logsys::LogMsg &msg)
+        {
+            stringstream ss;
+            for (auto &item : _items)
+            {
+                switch (item._key)
+                {
+                case 'd':
+                {
+                    time_t t = msg._time;
+                    struct tm _tm;
+                    localtime_r(&t, &_tm);
+                    char s[128];
+                    strftime(s, 127, item._value.c_str(), &_tm);
+                    ss << s;
+                    break;
+                }
+                case 't': ss << msg._tid; break;
+                case 'p': ss << logsys::toString(msg._level); break;
+                case 'c': ss << msg._name; break;
+                case 'f': ss << msg._file; break;
+                case 'l': ss << msg._line; break;
+                case 'm': ss << msg._payload; break;
+                case 'n': ss << '\n'; break;
+                default: ss << item._value; break;
+                }
+            }
+            return ss.str();
+        }
+    private:
+        vector<Item> _items;
+    };
+};
+
+template <class F>
+void run(const char *name, size_t n, F &&f)
+{
+    size_t bytes = 0;
+    auto begin = chrono::steady_clock::now();
+    for (size_t i = 0; i < n; ++i) bytes += f();
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count();
+    cout << "{\"bench\":\"" << name << "\",\"iterations\":" << n << ",\"ns_per_op\":" << (double)ns / n
+         << ",\"bytes\":" << bytes << "}\n";
+}
+
+int main(int argc, char *argv[])
+{
+    size_t n = argc > 1 ? stoul(argv[1]) : 1000000;
+    logsys::LogMsg msg("root", "bench/format_bench.cc", 128, "This is a benchmark payload of moderate length", logsys::Level::INFO);
+    // [%d{%H:%M:%S}][%t][%p][%c][%f:%l] %m%n
+    legacy::StreamFormat old_fmt({{'o', "["}, {'d', "%H:%M:%S"}, {'o', "]["}, {'t', ""}, {'o', "]["}, {'p', ""},
+                                  {'o', "]["}, {'c', ""}, {'o', "]["}, {'f', ""}, {'o', ":"}, {'l', ""},
+                                  {'o', "] "}, {'m', ""}, {'n', ""}});
+    logsys::Format new_fmt("[%d{%H:%M:%S}][%t][%p][%c][%f:%l] %m%n");
+    logsys::StaticFormat<"[%d{%H:%M:%S}][%t][%p][%c][%f:%l] %m%n"> static_fmt;
+
+    run("stringstream", n, [&]() {
+        string str = old_fmt.format(msg);
+        return str.size();
+    });
+    string out;
+    run("append_buffer", n, [&]() {
+        out.clear();
+        new_fmt.format(out, msg);
+        return out.size();
+    });
+    run("static_format", n, [&]() {
+        out.clear();
+        static_fmt.format(out, msg);
+        return out.size();
+    });
+    return 0;
+}
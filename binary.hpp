@@ -0,0 +1,550 @@
+#pragma once
+
+#include "util.hpp"
+#include "level.hpp"
+#include "message.hpp"
+#include "format.hpp"
+#include "deferred.hpp"
+#include "sink.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <charconv>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+// 二进制日志格式：不做文本格式化，只记录调用点编号、时间增量、线程编号与原始参数，由离线工具按任意格式模式还原为文本
+// 流的组成（整数均为LEB128变长编码，有符号数先做zigzag变换，字符串为长度+内容）：
+//   BEGIN  "LOGB" 版本 sizeof(std::thread::id)  流的开始，清空字典
+//   SITE   编号 等级 行号 日志器名称 文件名 格式串 参数类型   调用点首次出现时写入，此后只引用编号
+//   THREAD 编号 std::thread::id的原始字节                     线程首次出现时写入
+//   RECORD 调用点编号 时间增量（纳秒） 线程编号 参数...          参数按类型标记编码（见DeferredCodec::typeTag）
+//   TEXT   文本                                               未经日志器而直接写入落地方向的文本
+// 每个文件都以BEGIN开始并自带字典，可以单独解码；浮点数与线程ID按本机字节序存放，需在相同平台上解码
+namespace logsys
+{
+    enum class BinaryTag : uint8_t
+    {
+        BEGIN = 0,
+        SITE,
+        THREAD,
+        RECORD,
+        TEXT
+    };
+    const char BINARY_MAGIC[4] = {'L', 'O', 'G', 'B'};
+    const uint8_t BINARY_VERSION = 1;
+
+    class BinaryEncoder
+    {
+    public:
+        BinaryEncoder() : _last_ns(0) {}
+        // 开始新的流，此后的调用点与线程会重新写入字典
+        void begin(std::string &out)
+        {
+            _sites.clear();
+            _threads.clear();
+            _last_ns = 0;
+            out += static_cast<char>(BinaryTag::BEGIN);
+            out.append(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+            out += static_cast<char>(BINARY_VERSION);
+            out += static_cast<char>(sizeof(std::thread::id));
+        }
+        // 编码一条延迟格式化记录，参数见DeferredCodec::foreach
+        void encode(std::string &out, const std::string &name, const DeferredRecord &rec,
+                    std::string_view file, std::string_view fmt, const char *args)
+        {
+            //long double的精度与表示依赖平台，含有它的记录先格式化为消息，按已格式化记录存放，解码结果与文本输出一致
+            if (rec._decode && std::strchr(rec._types, 'g'))
+            {
+                _payload.clear();
+                try { rec._decode(args, fmt, _payload); }
+                catch (const std::format_error &e) { _payload.assign("Invalid log format: ").append(fmt); }
+                DeferredRecord text = rec;
+                text._decode = nullptr;
+                text._site = nullptr;
+                encode(out, name, text, file, _payload, nullptr);
+                return;
+            }
+            uint64_t site = siteId(out, name, rec, file, fmt);
+            uint64_t thread = threadId(out, rec._tid);
+            int64_t ns = (int64_t)rec._time * NSEC_PER_SEC + rec._nsec;
+            out += static_cast<char>(BinaryTag::RECORD);
+            putVarint(out, site);
+            putVarint(out, zigzag(ns - _last_ns));
+            putVarint(out, thread);
+            _last_ns = ns;
+            //已格式化的消息作为调用点"{}"的唯一字符串参数
+            if (rec._decode == nullptr) putString(out, fmt);
+            else putArgs(out, rec._types, args);
+        }
+        void encodeText(std::string &out, std::string_view text)
+        {
+            out += static_cast<char>(BinaryTag::TEXT);
+            putString(out, text);
+        }
+
+    private:
+        uint64_t siteId(std::string &out, const std::string &name, const DeferredRecord &rec,
+                        std::string_view file, std::string_view fmt)
+        {
+            //日志宏产生的记录以调用点地址区分，其余记录以内容区分
+            _key.clear();
+            std::string_view types = rec._decode ? rec._types : "s";
+            if (rec._decode == nullptr) fmt = "{}";
+            if (rec._site) _key.append(reinterpret_cast<const char *>(&rec._site), sizeof(rec._site));
+            else
+            {
+                _key.append(file);
+                _key += '\0';
+                _key.append(fmt);
+                _key += '\0';
+                _key.append(types);
+                _key += '\0';
+                _key.append(reinterpret_cast<const char *>(&rec._line), sizeof(rec._line));
+                _key += static_cast<char>(rec._level);
+            }
+            _key.append(name);
+            auto it = _sites.find(_key);
+            if (it != _sites.end()) return it->second;
+            uint64_t id = _sites.size();
+            _sites.emplace(_key, id);
+            out += static_cast<char>(BinaryTag::SITE);
+            putVarint(out, id);
+            out += static_cast<char>(rec._level);
+            putVarint(out, rec._line);
+            putString(out, name);
+            putString(out, file);
+            putString(out, fmt);
+            putVarint(out, types.size());
+            out.append(types);
+            return id;
+        }
+        uint64_t threadId(std::string &out, std::thread::id tid)
+        {
+            auto it = _threads.find(tid);
+            if (it != _threads.end()) return it->second;
+            uint64_t id = _threads.size();
+            _threads.emplace(tid, id);
+            out += static_cast<char>(BinaryTag::THREAD);
+            putVarint(out, id);
+            out.append(reinterpret_cast<const char *>(&tid), sizeof(tid));
+            return id;
+        }
+        template <class T>
+        static T load(const char *&p)
+        {
+            T value;
+            std::memcpy(&value, p, sizeof(value));
+            p += sizeof(value);
+            return value;
+        }
+        template <class T>
+        static void putRaw(std::string &out, T value)
+        {
+            out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+        static void putArgs(std::string &out, const char *types, const char *args)
+        {
+            for (; *types; ++types)
+            {
+                switch (*types)
+                {
+                case 's':
+                {
+                    uint32_t len = load<uint32_t>(args);
+                    putString(out, std::string_view(args, len));
+                    args += len;
+                    break;
+                }
+                case '?': case 'c': case 'b': case 'B': out += *args++; break;
+                case 'h': putVarint(out, zigzag(load<int16_t>(args))); break;
+                case 'i': putVarint(out, zigzag(load<int32_t>(args))); break;
+                case 'q': putVarint(out, zigzag(load<int64_t>(args))); break;
+                case 'H': putVarint(out, load<uint16_t>(args)); break;
+                case 'I': putVarint(out, load<uint32_t>(args)); break;
+                case 'Q': putVarint(out, load<uint64_t>(args)); break;
+                case 'f': putRaw(out, load<float>(args)); break;
+                case 'd': putRaw(out, load<double>(args)); break;
+                case 'P': putVarint(out, reinterpret_cast<uintptr_t>(load<const void *>(args))); break;
+                }
+            }
+        }
+
+    public:
+        static uint64_t zigzag(int64_t value) { return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63); }
+        static void putVarint(std::string &out, uint64_t value)
+        {
+            while (value >= 0x80)
+            {
+                out += static_cast<char>(value | 0x80);
+                value >>= 7;
+            }
+            out += static_cast<char>(value);
+        }
+        static void putString(std::string &out, std::string_view str)
+        {
+            putVarint(out, str.size());
+            out.append(str);
+        }
+
+    private:
+        std::unordered_map<std::string, uint64_t> _sites;
+        std::unordered_map<std::thread::id, uint64_t> _threads;
+        int64_t _last_ns;  // 上一条记录的时间
+        std::string _key;  // 查找调用点时复用
+        std::string _payload; // 含long double参数的记录格式化后的消息
+    };
+
+    // 解码器可以分块喂入数据：每次返回已解码的字节数，末尾不完整的记录留待下次连同后续数据一起传入
+    class BinaryDecoder
+    {
+    public:
+        BinaryDecoder() : _last_ns(0), _begun(false) {}
+        // 每条日志调用f(const LogMsg *msg, std::string_view text)，TEXT记录的msg为空
+        // 数据损坏时抛出std::runtime_error
+        template <class F>
+        size_t decode(const char *data, size_t len, F &&f)
+        {
+            size_t consumed = 0;
+            while (consumed < len)
+            {
+                Reader reader{data + consumed, data + len};
+                if (!next(reader, f)) break;
+                consumed = reader._p - data;
+            }
+            return consumed;
+        }
+        // 按format渲染为文本，追加到out
+        size_t render(const char *data, size_t len, Format &format, std::string &out)
+        {
+            return decode(data, len, [&](const LogMsg *msg, std::string_view text) {
+                if (msg) format.format(out, *msg);
+                else out.append(text);
+            });
+        }
+
+    private:
+        struct Site
+        {
+            Level _level;
+            size_t _line;
+            std::string _name;
+            std::string _file;
+            std::string _fmt;
+            std::string _types;
+        };
+        struct Value
+        {
+            char _tag;
+            std::string_view _str;
+            int64_t _int;
+            uint64_t _uint;
+            float _float;
+            double _double;
+        };
+        // 读取越界时_ok置为false，说明记录不完整
+        struct Reader
+        {
+            const char *_p;
+            const char *_end;
+            bool _ok = true;
+
+            bool has(size_t n)
+            {
+                if ((size_t)(_end - _p) < n) _ok = false;
+                return _ok;
+            }
+            uint8_t byte() { return has(1) ? static_cast<uint8_t>(*_p++) : 0; }
+            uint64_t varint()
+            {
+                uint64_t value = 0;
+                for (int shift = 0; shift < 64 && has(1); shift += 7)
+                {
+                    uint8_t b = *_p++;
+                    value |= (uint64_t)(b & 0x7f) << shift;
+                    if (!(b & 0x80)) return value;
+                }
+                _ok = false;
+                return 0;
+            }
+            int64_t svarint()
+            {
+                uint64_t value = varint();
+                return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+            }
+            std::string_view string()
+            {
+                uint64_t len = varint();
+                if (!has(len)) return {};
+                std::string_view str(_p, len);
+                _p += len;
+                return str;
+            }
+            template <class T>
+            T raw()
+            {
+                T value{};
+                if (!has(sizeof(value))) return value;
+                std::memcpy(&value, _p, sizeof(value));
+                _p += sizeof(value);
+                return value;
+            }
+        };
+
+        template <class F>
+        bool next(Reader &reader, F &f)
+        {
+            BinaryTag tag = static_cast<BinaryTag>(reader.byte());
+            if (!reader._ok) return false;
+            if (!_begun && tag != BinaryTag::BEGIN)
+                throw std::runtime_error("not a binary log stream");
+            switch (tag)
+            {
+            case BinaryTag::BEGIN:
+            {
+                if (!reader.has(sizeof(BINARY_MAGIC) + 2)) return false;
+                if (std::memcmp(reader._p, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0 ||
+                    (uint8_t)reader._p[sizeof(BINARY_MAGIC)] != BINARY_VERSION)
+                    throw std::runtime_error("unsupported binary log version");
+                _tid_size = (uint8_t)reader._p[sizeof(BINARY_MAGIC) + 1];
+                reader._p += sizeof(BINARY_MAGIC) + 2;
+                _sites.clear();
+                _threads.clear();
+                _last_ns = 0;
+                _begun = true;
+                return true;
+            }
+            case BinaryTag::SITE:
+            {
+                Site site;
+                uint64_t id = reader.varint();
+                site._level = static_cast<Level>(reader.byte());
+                site._line = reader.varint();
+                site._name = reader.string();
+                site._file = reader.string();
+                site._fmt = reader.string();
+                site._types = reader.string();
+                if (!reader._ok) return false;
+                if (id >= _sites.size()) _sites.resize(id + 1);
+                _sites[id] = std::move(site);
+                return true;
+            }
+            case BinaryTag::THREAD:
+            {
+                uint64_t id = reader.varint();
+                if (!reader.has(_tid_size)) return false;
+                std::thread::id tid;
+                if (_tid_size == sizeof(tid)) std::memcpy(&tid, reader._p, sizeof(tid));
+                reader._p += _tid_size;
+                if (id >= _threads.size()) _threads.resize(id + 1);
+                _threads[id] = tid;
+                return true;
+            }
+            case BinaryTag::RECORD:
+            {
+                uint64_t site_id = reader.varint();
+                int64_t delta = reader.svarint();
+                uint64_t thread_id = reader.varint();
+                if (!reader._ok) return false;
+                if (site_id >= _sites.size() || thread_id >= _threads.size())
+                    throw std::runtime_error("binary log record refers to an undefined call site or thread");
+                const Site &site = _sites[site_id];
+                _args.clear();
+                for (char t : site._types)
+                    _args.push_back(readValue(reader, t));
+                if (!reader._ok) return false;
+                int64_t ns = _last_ns + delta;
+                _last_ns = ns;
+                std::string payload;
+                try { formatPayload(site._fmt, payload); }
+                catch (const std::exception &e) { payload = "Invalid log format: " + site._fmt; }
+                LogMsg msg(site._name, site._file, site._line, payload, site._level,
+                           ns / NSEC_PER_SEC, ns % NSEC_PER_SEC, _threads[thread_id]);
+                f(&msg, std::string_view());
+                return true;
+            }
+            case BinaryTag::TEXT:
+            {
+                std::string_view text = reader.string();
+                if (!reader._ok) return false;
+                f(nullptr, text);
+                return true;
+            }
+            }
+            throw std::runtime_error("corrupted binary log");
+        }
+        static Value readValue(Reader &reader, char tag)
+        {
+            Value value{tag, {}, 0, 0, 0, 0};
+            switch (tag)
+            {
+            case 's': value._str = reader.string(); break;
+            case '?': case 'c': value._int = (char)reader.byte(); break;
+            case 'b': value._int = (signed char)reader.byte(); break;
+            case 'B': value._uint = reader.byte(); break;
+            case 'h': case 'i': case 'q': value._int = reader.svarint(); break;
+            case 'H': case 'I': case 'Q': case 'P': value._uint = reader.varint(); break;
+            case 'f': value._float = reader.raw<float>(); break;
+            case 'd': value._double = reader.raw<double>(); break;
+            default: throw std::runtime_error("unknown argument type in binary log");
+            }
+            return value;
+        }
+        // 逐个替换字段调用std::vformat，格式说明与std::format一致（不支持嵌套的动态宽度与精度）
+        void formatPayload(std::string_view fmt, std::string &out)
+        {
+            size_t next = 0;
+            for (size_t i = 0; i < fmt.size(); ++i)
+            {
+                char c = fmt[i];
+                if (c == '}')
+                {
+                    if (i + 1 == fmt.size() || fmt[i + 1] != '}') throw std::format_error("unmatched '}'");
+                    out += '}';
+                    ++i;
+                    continue;
+                }
+                if (c != '{')
+                {
+                    out += c;
+                    continue;
+                }
+                if (i + 1 < fmt.size() && fmt[i + 1] == '{')
+                {
+                    out += '{';
+                    ++i;
+                    continue;
+                }
+                size_t end = fmt.find('}', i);
+                if (end == std::string_view::npos) throw std::format_error("unmatched '{'");
+                std::string_view field = fmt.substr(i + 1, end - i - 1);
+                size_t colon = std::min(field.find(':'), field.size());
+                size_t index = next++;
+                if (colon != 0)
+                {
+                    auto ret = std::from_chars(field.data(), field.data() + colon, index);
+                    if (ret.ec != std::errc() || ret.ptr != field.data() + colon)
+                        throw std::format_error("invalid argument index");
+                }
+                _spec.assign("{");
+                _spec.append(field.substr(colon));
+                _spec += '}';
+                formatValue(_args.at(index), _spec, out);
+                i = end;
+            }
+        }
+        static void formatValue(const Value &value, std::string_view spec, std::string &out)
+        {
+            auto put = [&](auto arg) { std::vformat_to(std::back_inserter(out), spec, std::make_format_args(arg)); };
+            switch (value._tag)
+            {
+            case 's': put(value._str); break;
+            case '?': put((bool)value._int); break;
+            case 'c': put((char)value._int); break;
+            case 'b': case 'h': case 'i': case 'q': put(value._int); break;
+            case 'B': case 'H': case 'I': case 'Q': put(value._uint); break;
+            case 'f': put(value._float); break;
+            case 'd': put(value._double); break;
+            case 'P': put(reinterpret_cast<const void *>(value._uint)); break;
+            }
+        }
+
+    private:
+        std::vector<Site> _sites;
+        std::vector<std::thread::id> _threads;
+        std::vector<Value> _args;
+        std::string _spec;
+        int64_t _last_ns;
+        size_t _tid_size;
+        bool _begun;
+    };
+
+    // 二进制文件落地：直接接收延迟格式化记录并按上述格式写入，日志器不再为它渲染文本
+    // 用tools/log_decode按任意格式模式还原为文本；滚动后的每个文件都自带字典，可以单独解码
+    class BinaryFileLogSink : public LogSink
+    {
+    public:
+        // max_size为0表示不滚动
+        BinaryFileLogSink(const std::string &filename, size_t max_size = 0)
+            : _filename(filename),
+              _max_size(max_size),
+              _cur_size(0),
+              _cur_suffix(1)
+        {
+            File::createDirectory(File::getPath(filename));
+        }
+        bool acceptRecords() const override { return true; }
+        // 不经过日志器的文本（如被独立落地包装时）原样记录为TEXT
+        void log(const char *data, size_t len) override
+        {
+            Fragment frag{data, len};
+            logBatch(&frag, 1);
+        }
+        void logBatch(const Fragment *frags, size_t n) override
+        {
+            checkStat();
+            for (size_t i = 0; i < n; ++i)
+                _encoder.encodeText(_out, std::string_view(frags[i]._data, frags[i]._len));
+            write();
+        }
+        void logRecords(const Fragment *frags, size_t n, const std::string &name) override
+        {
+            checkStat();
+            for (size_t i = 0; i < n; ++i)
+                DeferredCodec::foreach(frags[i]._data, frags[i]._len,
+                    [&](const DeferredRecord &rec, std::string_view file, std::string_view fmt, const char *args) {
+                        _encoder.encode(_out, name, rec, file, fmt, args);
+                    });
+            write();
+        }
+        void sync() override
+        {
+            _file.sync();
+        }
+        size_t errors() const override { return _file.errors(); }
+        size_t lostBytes() const override { return _file.lostBytes(); }
+        ~BinaryFileLogSink()
+        {
+            if (syncEnabled()) _file.sync();
+        }
+
+    private:
+        void write()
+        {
+            _file.write(_out.data(), _out.size());
+            _cur_size += _out.size();
+            _out.clear();
+        }
+        // 每个新文件（包括追加到已有文件）都以BEGIN开始
+        void checkStat()
+        {
+            if (_file.isOpen() && (_max_size == 0 || _cur_size < _max_size)) return;
+            if (syncEnabled()) _file.sync();
+            _file.open(_max_size == 0 ? _filename : newFileName());
+            _cur_size = 0;
+            _encoder.begin(_out);
+        }
+        std::string newFileName()
+        {
+            time_t t = logsys::Date::now();
+            struct tm _tm;
+            localtime_r(&t, &_tm);
+            char s[128];
+            strftime(s, 127, "%Y%m%d%H%M%S", &_tm);
+            return _filename + s + "-" + std::to_string(_cur_suffix++);
+        }
+
+    private:
+        std::string _filename;
+        LogFile _file;
+        BinaryEncoder _encoder;
+        std::string _out;  // 当前批次的编码结果
+        size_t _max_size;
+        size_t _cur_size;
+        size_t _cur_suffix;
+    };
+};
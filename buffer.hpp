@@ -2,56 +2,147 @@
 
 #include <iostream>
 #include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <stdexcept>
 
-namespace log
+namespace logsys
 {
     const size_t BUFFER_DEFAULT_SIZE = 8 * 1024 * 1024;
     const size_t BUFFER_INCREACE_SIZE = 1 * 1024 * 1024;
     const size_t BUFFER_THRESHOLD_SIZE = 8 * 1024 * 1024;
+    const size_t BUFFER_INITIAL_SIZE = 4 * 1024; // 首次实际分配的内存大小
+    const size_t BUFFER_SHRINK_ROUNDS = 64;      // 用量连续偏低多少轮后收缩
+    const size_t BUFFER_SHRINK_INTERVAL = 10;    // 且用量持续偏低多少秒后收缩
+
+    // 一段连续数据（类似iovec），异步线程以数组形式一次性把整批数据交给落地方向
+    struct Fragment
+    {
+        const char *_data;
+        size_t _len;
+    };
+
+    // 缓冲区：容量（_limit）是逻辑上限，写满后由使用者按溢出策略处理；实际内存按需分配，不做初始化，
+    // 从BUFFER_INITIAL_SIZE开始成倍增长，直到逻辑上限。低流量的缓冲区只占用几KB，
+    // 突发流量过后若长期用不到实际容量的1/4，则在reset时收缩；收缩条件同时限定轮数与时间，避免流量波动时反复分配
     class Buffer
     {
     public:
-        Buffer()
-            : _read_ptr(0),
+        Buffer(size_t size = BUFFER_DEFAULT_SIZE)
+            : _size(std::max(size, BUFFER_INITIAL_SIZE)), //容量为0时成倍扩容无法终止
+              _limit(_size),
+              _capacity(0),
+              _read_ptr(0),
               _write_ptr(0),
-              _container(BUFFER_DEFAULT_SIZE)
+              _peak(0),
+              _idle_rounds(0)
         {}
         bool empty() { return _read_ptr == _write_ptr; }
         size_t readAbleSize() { return _write_ptr - _read_ptr; }
-        size_t writeAbleSize() { return _container.size() - _write_ptr; }
-        void reset() { _write_ptr = _read_ptr = 0; }
+        size_t writeAbleSize() { return _limit - _write_ptr; }
+        size_t capacity() { return _limit; }
+        // 实际分配的内存大小
+        size_t allocated() { return _capacity; }
+        void reset()
+        {
+            size_t used = _write_ptr;
+            _write_ptr = _read_ptr = 0;
+            shrink(used);
+        }
         void swap(Buffer &buffer)
         {
+            std::swap(_size, buffer._size);
+            std::swap(_limit, buffer._limit);
+            std::swap(_capacity, buffer._capacity);
             std::swap(_read_ptr, buffer._read_ptr);
             std::swap(_write_ptr, buffer._write_ptr);
+            std::swap(_peak, buffer._peak);
+            std::swap(_idle_rounds, buffer._idle_rounds);
+            std::swap(_idle_since, buffer._idle_since);
             _container.swap(buffer._container);
         }
         void push(const char *data, size_t len)
         {
             ensureEnoughSpace(len);
-            std::copy(data, data + len, _container.data() + _write_ptr);
+            std::memcpy(_container.get() + _write_ptr, data, len);
             _write_ptr += len;
         }
-        const char *begin() {return _container.data() + _read_ptr;}
+        const char *begin() {return _container.get() + _read_ptr;}
         void pop(size_t len) {
             if(len > readAbleSize()) throw std::runtime_error("Unauthorized access to container");
             _read_ptr += len;
         }
+        // 将未读数据挪到缓冲区头部，回收已读部分的空间
+        void compact()
+        {
+            if(_read_ptr == 0) return;
+            size_t len = readAbleSize();
+            std::memmove(_container.get(), _container.get() + _read_ptr, len);
+            _read_ptr = 0;
+            _write_ptr = len;
+        }
 
     private:
         void ensureEnoughSpace(size_t len)
         {
-            //写入长度超出可写长度范围，需要扩容
+            //写入长度超出可写长度范围，需要扩容（仅GROW策略或单条数据超过容量时发生）
             while(len > writeAbleSize())
             {
                 //小于阈值则指数增长扩容
-                if(len < BUFFER_THRESHOLD_SIZE) _container.resize(_container.size() << 1);
+                if(len < BUFFER_THRESHOLD_SIZE) _limit <<= 1;
                 //否则线性增长
-                else _container.resize(_container.size() + BUFFER_INCREACE_SIZE);
+                else _limit += BUFFER_INCREACE_SIZE;
             }
+            if(_write_ptr + len > _capacity) reallocate(readAbleSize() + len);
         }
+        // 重新分配实际内存，只拷贝未读数据
+        void reallocate(size_t need)
+        {
+            size_t cap = std::max(_capacity, BUFFER_INITIAL_SIZE);
+            while(cap < need) cap <<= 1;
+            cap = std::max(std::min(cap, _limit), need);
+            auto container = std::make_unique_for_overwrite<char[]>(cap);
+            size_t len = readAbleSize();
+            if(len) std::memcpy(container.get(), _container.get() + _read_ptr, len);
+            _container = std::move(container);
+            _capacity = cap;
+            _read_ptr = 0;
+            _write_ptr = len;
+        }
+        // 连续BUFFER_SHRINK_ROUNDS轮、至少BUFFER_SHRINK_INTERVAL秒的用量都不足实际容量的1/4时，收缩到期间最大用量的两倍
+        void shrink(size_t used)
+        {
+            if(_capacity <= BUFFER_INITIAL_SIZE || used * 4 >= _capacity)
+            {
+                _peak = 0;
+                _idle_rounds = 0;
+                return;
+            }
+            _peak = std::max(_peak, used);
+            auto now = std::chrono::steady_clock::now();
+            if(_idle_rounds++ == 0) _idle_since = now;
+            if(_idle_rounds < BUFFER_SHRINK_ROUNDS || now - _idle_since < std::chrono::seconds(BUFFER_SHRINK_INTERVAL))
+                return;
+            size_t cap = BUFFER_INITIAL_SIZE;
+            while(cap < _peak * 2) cap <<= 1;
+            _container = std::make_unique_for_overwrite<char[]>(cap);
+            _capacity = cap;
+            //扩容过的逻辑上限也恢复为设定值
+            _limit = std::max(_size, cap);
+            _peak = 0;
+            _idle_rounds = 0;
+        }
+
+        size_t _size;         // 设定的逻辑容量
+        size_t _limit;        // 当前的逻辑容量，扩容后可能大于_size
+        size_t _capacity;     // 实际分配的内存大小
         size_t _read_ptr;
         size_t _write_ptr;
-        std::vector<char> _container;
+        size_t _peak;         // 收缩观察期内的最大用量
+        size_t _idle_rounds;  // 用量连续偏低的轮数
+        std::chrono::steady_clock::time_point _idle_since; // 用量开始偏低的时间
+        std::unique_ptr<char[]> _container;
     };
 };
\ No newline at end of file
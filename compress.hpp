@@ -0,0 +1,396 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#ifdef LOG_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef LOG_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// 压缩：gzip（链接zlib时使用zlib，否则使用内置的固定哈夫曼deflate实现）与zstd（需定义LOG_WITH_ZSTD）
+// 压缩流每次finish输出一个完整的gzip成员/zstd帧，之后可以继续压缩下一段，各段可以独立解压
+namespace logsys
+{
+    enum class CompressType
+    {
+        NONE = 0,
+        GZIP,
+        ZSTD
+    };
+    inline const char *compressSuffix(CompressType type)
+    {
+        switch (type)
+        {
+        case CompressType::GZIP:
+            return ".gz";
+        case CompressType::ZSTD:
+            return ".zst";
+        default:
+            return "";
+        }
+    }
+    // 未链接zstd时退化为gzip
+    inline CompressType availableCompress(CompressType type)
+    {
+#ifndef LOG_WITH_ZSTD
+        if (type == CompressType::ZSTD) return CompressType::GZIP;
+#endif
+        return type;
+    }
+
+    inline uint32_t crc32Update(uint32_t crc, const char *data, size_t len)
+    {
+#ifdef LOG_WITH_ZLIB
+        return ::crc32(crc, reinterpret_cast<const Bytef *>(data), len);
+#else
+        static const auto table = []() {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < len; ++i)
+            crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+#endif
+    }
+
+    // 内置deflate：LZ77（哈希链）+ 固定哈夫曼编码，压缩率低于zlib，但对重复度高的日志已经足够
+    // 匹配只在同一次compress调用的数据内查找，调用者应以较大的块为单位压缩
+    class FixedDeflater
+    {
+    public:
+        FixedDeflater(int level = 6) : _bits(0), _bit_cnt(0)
+        {
+            _max_chain = level <= 1 ? 4 : level >= 9 ? 256 : 8 << (level / 3);
+        }
+        // 输出一个非最终块
+        void compress(const char *data, size_t len, std::string &out)
+        {
+            if (len == 0) return;
+            putBits(0, 1); // BFINAL
+            putBits(1, 2); // BTYPE=01 固定哈夫曼
+            const uint8_t *src = reinterpret_cast<const uint8_t *>(data);
+            _head.assign(HASH_SIZE, -1);
+            _prev.resize(WINDOW_SIZE);
+            size_t pos = 0;
+            while (pos < len)
+            {
+                size_t best_len = 0, best_dist = 0;
+                if (pos + MIN_MATCH <= len)
+                {
+                    uint32_t h = hash(src + pos);
+                    int64_t cand = _head[h];
+                    size_t max_len = std::min(len - pos, MAX_MATCH);
+                    for (size_t chain = 0; cand >= 0 && pos - cand <= WINDOW_SIZE && chain < _max_chain; ++chain)
+                    {
+                        size_t l = 0;
+                        while (l < max_len && src[cand + l] == src[pos + l]) ++l;
+                        if (l > best_len)
+                        {
+                            best_len = l;
+                            best_dist = pos - cand;
+                            if (l == max_len) break;
+                        }
+                        int64_t next = _prev[cand & (WINDOW_SIZE - 1)];
+                        if (next >= cand) break;
+                        cand = next;
+                    }
+                }
+                if (best_len >= MIN_MATCH)
+                {
+                    putLength(best_len);
+                    putDistance(best_dist);
+                    for (size_t end = pos + best_len; pos < end; ++pos) insert(src, pos, len);
+                }
+                else
+                {
+                    putLiteral(src[pos]);
+                    insert(src, pos++, len);
+                }
+            }
+            putLiteral(256); // 块结束
+            flushBytes(out);
+        }
+        // 输出空的最终块并按字节对齐，之后可以开始新的deflate流
+        void finish(std::string &out)
+        {
+            putBits(1, 1);
+            putBits(1, 2);
+            putLiteral(256);
+            spill();
+            if (_bit_cnt) putBits(0, 8 - _bit_cnt);
+            flushBytes(out);
+        }
+
+    private:
+        static constexpr size_t WINDOW_SIZE = 32768;
+        static constexpr size_t HASH_SIZE = 1 << 15;
+        static constexpr size_t MIN_MATCH = 3;
+        static constexpr size_t MAX_MATCH = 258;
+
+        static uint32_t hash(const uint8_t *p)
+        {
+            return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> 17;
+        }
+        void insert(const uint8_t *src, size_t pos, size_t len)
+        {
+            if (pos + MIN_MATCH > len) return;
+            uint32_t h = hash(src + pos);
+            _prev[pos & (WINDOW_SIZE - 1)] = _head[h];
+            _head[h] = pos;
+        }
+        void putBits(uint32_t value, int cnt)
+        {
+            _bits |= static_cast<uint64_t>(value) << _bit_cnt;
+            _bit_cnt += cnt;
+        }
+        // 哈夫曼码按高位在前写入，需先反转
+        void putCode(uint32_t code, int cnt)
+        {
+            uint32_t rev = 0;
+            for (int i = 0; i < cnt; ++i) rev |= ((code >> i) & 1) << (cnt - 1 - i);
+            putBits(rev, cnt);
+        }
+        void putLiteral(uint32_t v)
+        {
+            if (v < 144) putCode(0x30 + v, 8);
+            else if (v < 256) putCode(0x190 + v - 144, 9);
+            else if (v < 280) putCode(v - 256, 7);
+            else putCode(0xC0 + v - 280, 8);
+            if (_bit_cnt >= 32) spill();
+        }
+        void putLength(size_t len)
+        {
+            static const uint16_t base[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+            static const uint8_t extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+            size_t i = 28;
+            while (base[i] > len) --i;
+            putLiteral(257 + i);
+            putBits(len - base[i], extra[i]);
+            if (_bit_cnt >= 32) spill();
+        }
+        void putDistance(size_t dist)
+        {
+            static const uint16_t base[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                            193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                            6145, 8193, 12289, 16385, 24577};
+            size_t i = 29;
+            while (base[i] > dist) --i;
+            putCode(i, 5);
+            putBits(dist - base[i], i < 4 ? 0 : i / 2 - 1);
+            if (_bit_cnt >= 32) spill();
+        }
+        void spill()
+        {
+            while (_bit_cnt >= 8)
+            {
+                _pending.push_back(static_cast<char>(_bits & 0xFF));
+                _bits >>= 8;
+                _bit_cnt -= 8;
+            }
+        }
+        // 输出完整的字节，不足一字节的位留到下次
+        void flushBytes(std::string &out)
+        {
+            spill();
+            out.append(_pending);
+            _pending.clear();
+        }
+
+    private:
+        uint64_t _bits;
+        int _bit_cnt;
+        size_t _max_chain;
+        std::string _pending;
+        std::vector<int64_t> _head;
+        std::vector<int64_t> _prev;
+    };
+
+    // 压缩流，write追加压缩数据，finish结束当前gzip成员/zstd帧
+    class CompressStream
+    {
+    public:
+        // level小于0表示使用默认压缩等级
+        CompressStream(CompressType type, int level = -1)
+            : _type(availableCompress(type)),
+              _level(level),
+              _crc(0),
+              _size(0),
+              _started(false)
+#ifndef LOG_WITH_ZLIB
+              , _deflater(level < 0 ? 6 : level)
+#endif
+        {
+#ifdef LOG_WITH_ZLIB
+            if (_type == CompressType::GZIP)
+            {
+                std::memset(&_zs, 0, sizeof(_zs));
+                if (deflateInit2(&_zs, level < 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED, 15 + 16, 8,
+                                 Z_DEFAULT_STRATEGY) != Z_OK)
+                    throw std::runtime_error("deflateInit2 failed");
+            }
+#endif
+#ifdef LOG_WITH_ZSTD
+            if (_type == CompressType::ZSTD)
+            {
+                _zstd = ZSTD_createCCtx();
+                if (_zstd == nullptr) throw std::runtime_error("ZSTD_createCCtx failed");
+                ZSTD_CCtx_setParameter(_zstd, ZSTD_c_compressionLevel, level < 0 ? ZSTD_CLEVEL_DEFAULT : level);
+                ZSTD_CCtx_setParameter(_zstd, ZSTD_c_checksumFlag, 1);
+            }
+#endif
+        }
+        ~CompressStream()
+        {
+#ifdef LOG_WITH_ZLIB
+            if (_type == CompressType::GZIP) deflateEnd(&_zs);
+#endif
+#ifdef LOG_WITH_ZSTD
+            if (_type == CompressType::ZSTD) ZSTD_freeCCtx(_zstd);
+#endif
+        }
+        CompressStream(const CompressStream &) = delete;
+        CompressStream &operator=(const CompressStream &) = delete;
+
+        CompressType type() const { return _type; }
+        void write(const char *data, size_t len, std::string &out)
+        {
+            _started = true;
+            if (_type == CompressType::NONE)
+            {
+                out.append(data, len);
+                return;
+            }
+            if (_type == CompressType::ZSTD)
+            {
+                zstd(data, len, false, out);
+                return;
+            }
+            gzip(data, len, false, out);
+        }
+        // 结束当前成员，未写入任何数据时不输出
+        void finish(std::string &out)
+        {
+            if (!_started) return;
+            _started = false;
+            if (_type == CompressType::ZSTD) zstd(nullptr, 0, true, out);
+            else if (_type == CompressType::GZIP) gzip(nullptr, 0, true, out);
+        }
+
+    private:
+        void gzip(const char *data, size_t len, bool end, std::string &out)
+        {
+#ifdef LOG_WITH_ZLIB
+            _zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+            _zs.avail_in = len;
+            int ret;
+            do
+            {
+                size_t old = out.size();
+                size_t room = deflateBound(&_zs, _zs.avail_in) + 64;
+                out.resize(old + room);
+                _zs.next_out = reinterpret_cast<Bytef *>(out.data() + old);
+                _zs.avail_out = room;
+                ret = deflate(&_zs, end ? Z_FINISH : Z_NO_FLUSH);
+                out.resize(old + room - _zs.avail_out);
+            } while (end ? ret != Z_STREAM_END : _zs.avail_in != 0);
+            if (end) deflateReset(&_zs);
+#else
+            if (!_header)
+            {
+                static const char header[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3};
+                out.append(header, sizeof(header));
+                _header = true;
+            }
+            if (!end)
+            {
+                _crc = crc32Update(_crc, data, len);
+                _size += len;
+                _deflater.compress(data, len, out);
+                return;
+            }
+            _deflater.finish(out);
+            char trailer[8];
+            for (int i = 0; i < 4; ++i) trailer[i] = _crc >> (8 * i) & 0xFF;
+            for (int i = 0; i < 4; ++i) trailer[4 + i] = _size >> (8 * i) & 0xFF;
+            out.append(trailer, sizeof(trailer));
+            _crc = 0;
+            _size = 0;
+            _header = false;
+#endif
+        }
+        void zstd(const char *data, size_t len, bool end, std::string &out)
+        {
+#ifdef LOG_WITH_ZSTD
+            ZSTD_inBuffer in{data, len, 0};
+            size_t remaining;
+            do
+            {
+                size_t old = out.size();
+                size_t room = ZSTD_CStreamOutSize();
+                out.resize(old + room);
+                ZSTD_outBuffer output{out.data() + old, room, 0};
+                remaining = ZSTD_compressStream2(_zstd, &output, &in, end ? ZSTD_e_end : ZSTD_e_continue);
+                if (ZSTD_isError(remaining)) throw std::runtime_error(ZSTD_getErrorName(remaining));
+                out.resize(old + output.pos);
+            } while (end ? remaining != 0 : in.pos != in.size);
+#endif
+        }
+
+    private:
+        CompressType _type;
+        int _level;
+        uint32_t _crc;   // 内置gzip使用
+        uint32_t _size;
+        bool _started;   // 当前成员是否已写入数据
+#ifdef LOG_WITH_ZLIB
+        z_stream _zs;
+#else
+        bool _header = false;
+        FixedDeflater _deflater;
+#endif
+#ifdef LOG_WITH_ZSTD
+        ZSTD_CCtx *_zstd = nullptr;
+#endif
+    };
+
+    // 把文件压缩为dst，成功返回true
+    inline bool compressFile(const std::string &src, const std::string &dst, CompressType type, int level = -1)
+    {
+        std::ifstream ifs(src, std::ios::binary);
+        std::ofstream ofs(dst, std::ios::binary | std::ios::trunc);
+        if (!ifs.is_open() || !ofs.is_open()) return false;
+        CompressStream stream(type, level);
+        std::vector<char> buf(1024 * 1024);
+        std::string out;
+        //空文件也要输出完整的头尾
+        stream.write(buf.data(), 0, out);
+        while (ifs)
+        {
+            ifs.read(buf.data(), buf.size());
+            if (ifs.gcount() == 0) break;
+            stream.write(buf.data(), ifs.gcount(), out);
+            ofs.write(out.data(), out.size());
+            out.clear();
+        }
+        stream.finish(out);
+        ofs.write(out.data(), out.size());
+        ofs.close();
+        return !ifs.bad() && ofs.good();
+    }
+};
@@ -0,0 +1,254 @@
+#pragma once
+
+#include "level.hpp"
+#include "util.hpp"
+#include "message.hpp"
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <cstring>
+#include <ctime>
+#include <format>
+#include <iterator>
+#include <type_traits>
+
+// 延迟格式化：生产者只序列化原始参数，由异步线程完成std::vformat与Format格式化
+namespace logsys
+{
+    // 以字符串形式延迟的参数，序列化时拷贝其内容
+    template <class T>
+    concept DeferredString = std::is_same_v<std::decay_t<T>, const char *> ||
+                             std::is_same_v<std::decay_t<T>, char *> ||
+                             std::is_same_v<std::decay_t<T>, std::string> ||
+                             std::is_same_v<std::decay_t<T>, std::string_view>;
+    // 按值拷贝的算术类型：bool、char、1/2/4/8字节的整数与浮点数
+    // 宽字符类型与__int128、__float128等扩展类型没有对应的类型标记，不延迟，由生产者直接格式化
+    template <class T>
+    concept DeferredArithmetic = std::is_same_v<T, bool> || std::is_same_v<T, char> || std::is_same_v<T, float> ||
+                                 std::is_same_v<T, double> || std::is_same_v<T, long double> ||
+                                 (std::is_integral_v<T> && !std::is_same_v<T, wchar_t> &&
+                                  !std::is_same_v<T, char8_t> && !std::is_same_v<T, char16_t> &&
+                                  !std::is_same_v<T, char32_t> &&
+                                  (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8));
+    // 可以延迟格式化的参数：字符串与按值拷贝的算术类型、无类型指针
+    template <class T>
+    concept Deferrable = DeferredString<T> ||
+                         DeferredArithmetic<std::decay_t<T>> ||
+                         std::is_same_v<std::decay_t<T>, const void *> ||
+                         std::is_same_v<std::decay_t<T>, void *>;
+
+    // 记录头，记录布局：头部 | 文件名 | 格式串（或已格式化的消息） | 参数
+    // 由日志宏产生的记录只保存静态调用点的指针，不再拷贝文件名与格式串
+    struct DeferredRecord
+    {
+        using Decoder = void (*)(const char *args, std::string_view fmt, std::string &out);
+        uint32_t _size;      // 整条记录的长度
+        uint32_t _file_len;
+        uint32_t _fmt_len;
+        Level _level;
+        size_t _line;
+        time_t _time;
+        uint32_t _nsec;
+        std::thread::id _tid;
+        Decoder _decode;     // 为空表示格式串位置存放的是已格式化好的消息
+        const char *_types;  // 参数类型标记，每个参数一个字符，见DeferredCodec::typeTag
+        const CallSite *_site;
+    };
+    static_assert(std::is_trivially_copyable_v<DeferredRecord>);
+
+    class DeferredCodec
+    {
+    public:
+        template <class... Args>
+        static void encode(std::string &out, Level level, std::string_view file, size_t line,
+                           std::string_view fmt, const Args &...args)
+        {
+            size_t begin = out.size();
+            DeferredRecord rec = header(level, file, line, fmt);
+            rec._decode = &decode<std::decay_t<Args>...>;
+            rec._types = TYPE_TAGS<std::decay_t<Args>...>;
+            out.append(reinterpret_cast<const char *>(&rec), sizeof(rec));
+            out.append(file);
+            out.append(fmt);
+            (put(out, args), ...);
+            finish(out, begin);
+        }
+        template <class... Args>
+        static void encode(std::string &out, const CallSite &site, const Args &...args)
+        {
+            size_t begin = out.size();
+            DeferredRecord rec = header(site._level, {}, site._line, {});
+            rec._decode = &decode<std::decay_t<Args>...>;
+            rec._types = TYPE_TAGS<std::decay_t<Args>...>;
+            rec._site = &site;
+            out.append(reinterpret_cast<const char *>(&rec), sizeof(rec));
+            (put(out, args), ...);
+            finish(out, begin);
+        }
+        // 参数无法延迟时，由生产者格式化消息，其余部分（Format格式化）仍交给异步线程
+        // 结构化字段（键值对参数）跟在消息之后：{uint32键长, 键, uint32值长, 值, 是否加引号}
+        static void encodeFormatted(std::string &out, Level level, std::string_view file, size_t line,
+                                    std::string_view payload, const std::vector<LogField> &fields = {})
+        {
+            appendFormatted(out, header(level, file, line, payload), file, payload, fields);
+        }
+        // 以已有记录的等级、行号、时间与线程生成已格式化记录，供异步线程改写记录使用
+        static void encodeFormatted(std::string &out, const DeferredRecord &src, std::string_view file,
+                                    std::string_view payload, const std::vector<LogField> &fields = {})
+        {
+            DeferredRecord rec = header(src._level, file, src._line, payload);
+            rec._time = src._time;
+            rec._nsec = src._nsec;
+            rec._tid = src._tid;
+            appendFormatted(out, rec, file, payload, fields);
+        }
+        // 两条记录除时间与线程外完全相同：等级、调用点、格式串与参数（或已格式化的消息与字段）逐字节相等
+        static bool sameContent(const char *a, const char *b)
+        {
+            DeferredRecord x, y;
+            std::memcpy(&x, a, sizeof(x));
+            std::memcpy(&y, b, sizeof(y));
+            return x._size == y._size && x._level == y._level && x._line == y._line && x._site == y._site &&
+                   x._decode == y._decode && x._file_len == y._file_len && x._fmt_len == y._fmt_len &&
+                   std::memcmp(a + sizeof(x), b + sizeof(y), x._size - sizeof(x)) == 0;
+        }
+        // 读取已格式化记录中的结构化字段，args为foreach传给回调的参数位置
+        static void getFields(const DeferredRecord &rec, const char *args, std::vector<LogField> &fields)
+        {
+            const char *end = args + rec._size - sizeof(rec) - rec._file_len - rec._fmt_len;
+            while (args < end)
+            {
+                std::string_view key = get<std::string_view>(args);
+                std::string_view value = get<std::string_view>(args);
+                fields.push_back({std::string(key), std::string(value), *args++ != 0});
+            }
+        }
+        // 遍历一段连续数据中的所有记录，f(const DeferredRecord &, file, fmt, args)
+        template <class F>
+        static void foreach(const char *data, size_t len, F &&f)
+        {
+            const char *end = data + len;
+            while (data < end)
+            {
+                DeferredRecord rec;
+                std::memcpy(&rec, data, sizeof(rec));
+                const char *p = data + sizeof(rec);
+                std::string_view file(p, rec._file_len);
+                p += rec._file_len;
+                std::string_view fmt(p, rec._fmt_len);
+                p += rec._fmt_len;
+                if (rec._site)
+                {
+                    file = rec._site->_file;
+                    fmt = rec._site->_fmt;
+                }
+                f(rec, file, fmt, p);
+                data += rec._size;
+            }
+        }
+
+        // 参数的类型标记：s字符串，?布尔，c字符，b/h/i/q为1/2/4/8字节有符号整数（大写为无符号），
+        // f/d/g为float/double/long double，P为指针；参数在记录中的存放方式：字符串为uint32长度+内容，其余按值存放
+        template <class T>
+        static constexpr char typeTag()
+        {
+            if constexpr (DeferredString<T>) return 's';
+            else if constexpr (std::is_same_v<T, bool>) return '?';
+            else if constexpr (std::is_same_v<T, char>) return 'c';
+            else if constexpr (std::is_pointer_v<T>) return 'P';
+            else if constexpr (std::is_floating_point_v<T>) return sizeof(T) == 4 ? 'f' : sizeof(T) == 8 ? 'd' : 'g';
+            else
+            {
+                static_assert(DeferredArithmetic<T>, "参数类型没有对应的类型标记，不能延迟格式化");
+                char tag = sizeof(T) == 1 ? 'b' : sizeof(T) == 2 ? 'h' : sizeof(T) == 4 ? 'i' : 'q';
+                return std::is_signed_v<T> ? tag : tag - 'a' + 'A';
+            }
+        }
+        template <class... Args>
+        static constexpr char TYPE_TAGS[] = {typeTag<Args>()..., '\0'};
+
+    private:
+        template <class T>
+        using Stored = std::conditional_t<DeferredString<T>, std::string_view, std::decay_t<T>>;
+
+        static DeferredRecord header(Level level, std::string_view file, size_t line, std::string_view fmt)
+        {
+            DeferredRecord rec;
+            rec._size = 0;
+            rec._file_len = file.size();
+            rec._fmt_len = fmt.size();
+            rec._level = level;
+            rec._line = line;
+            int64_t ns = Date::nowNs();
+            rec._time = ns / NSEC_PER_SEC;
+            rec._nsec = ns % NSEC_PER_SEC;
+            rec._tid = std::this_thread::get_id();
+            rec._decode = nullptr;
+            rec._types = "";
+            rec._site = nullptr;
+            return rec;
+        }
+        static void appendFormatted(std::string &out, const DeferredRecord &rec, std::string_view file,
+                                    std::string_view payload, const std::vector<LogField> &fields)
+        {
+            size_t begin = out.size();
+            out.append(reinterpret_cast<const char *>(&rec), sizeof(rec));
+            out.append(file);
+            out.append(payload);
+            for (auto &field : fields)
+            {
+                put(out, std::string_view(field._key));
+                put(out, std::string_view(field._value));
+                out += static_cast<char>(field._quoted);
+            }
+            finish(out, begin);
+        }
+        static void finish(std::string &out, size_t begin)
+        {
+            uint32_t size = out.size() - begin;
+            std::memcpy(out.data() + begin, &size, sizeof(size));
+        }
+        template <class T>
+        static void put(std::string &out, const T &arg)
+        {
+            if constexpr (DeferredString<T>)
+            {
+                std::string_view sv(arg);
+                uint32_t len = sv.size();
+                out.append(reinterpret_cast<const char *>(&len), sizeof(len));
+                out.append(sv);
+            }
+            else out.append(reinterpret_cast<const char *>(&arg), sizeof(arg));
+        }
+        template <class T>
+        static Stored<T> get(const char *&p)
+        {
+            if constexpr (DeferredString<T>)
+            {
+                uint32_t len;
+                std::memcpy(&len, p, sizeof(len));
+                std::string_view sv(p + sizeof(len), len);
+                p += sizeof(len) + len;
+                return sv;
+            }
+            else
+            {
+                T arg;
+                std::memcpy(&arg, p, sizeof(arg));
+                p += sizeof(arg);
+                return arg;
+            }
+        }
+        template <class... Args>
+        static void decode(const char *args, std::string_view fmt, std::string &out)
+        {
+            //花括号初始化保证参数按顺序读取
+            std::tuple<Stored<Args>...> values{get<Args>(args)...};
+            std::apply([&](auto &...vs) {
+                std::vformat_to(std::back_inserter(out), fmt, std::make_format_args(vs...));
+            }, values);
+        }
+    };
+};
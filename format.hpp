@@ -5,118 +5,228 @@
 #include <cassert>
 #include <sstream>
 #include <tuple>
+#include <charconv>
+#include <array>
+#include <atomic>
 
-namespace log
+namespace logsys
 {
-    
+    // 线程ID转换为文本的开销较大，按线程缓存最近一次的结果
+    inline const std::string &threadIdString(std::thread::id tid)
+    {
+        thread_local std::thread::id cache_tid;
+        thread_local std::string cache_str;
+        if (cache_tid != tid || cache_str.empty())
+        {
+            std::stringstream ss;
+            ss << tid;
+            cache_str = ss.str();
+            cache_tid = tid;
+        }
+        return cache_str;
+    }
+
     class FormatItem
     {
     public:
         using ptr = std::shared_ptr<FormatItem>;
     public:
-        virtual void format(std::ostream &os, const LogMsg &msg) = 0;
+        virtual ~FormatItem() {}
+        // 直接追加到调用者提供的缓冲区中，避免ostream开销与额外拷贝
+        virtual void format(std::string &out, const LogMsg &msg) = 0;
     };
     class LineFormatItem: public FormatItem
     {
     public:
         LineFormatItem(const std::string &str){};
-        void format(std::ostream &os, const LogMsg &msg) override
+        void format(std::string &out, const LogMsg &msg) override
         {
-            os << msg._line;
+            char s[24];
+            out.append(s, std::to_chars(s, s + sizeof(s), msg._line).ptr - s);
         }
     };
+    const size_t TIME_CACHE_SIZE = 4; // 每个线程缓存的时间格式化子项个数
+    // 时间格式化：%d{...}中除strftime格式外，还支持%3N(毫秒)、%6N(微秒)、%9N或%N(纳秒)
+    // 秒级部分按线程、按秒缓存，同一秒内的日志只需渲染小数部分
     class TimeFormatItem: public FormatItem
     {
     public:
-        TimeFormatItem(const std::string &str = "%H:%M:%S"):_format(str){
+        TimeFormatItem(const std::string &str = "%H:%M:%S"):_format(str), _id(nextId()){
             if(_format.empty()) _format = "%H:%M:%S";
+            parseFormat();
         };
-        void format(std::ostream &os, const LogMsg &msg) override
+        void format(std::string &out, const LogMsg &msg) override
+        {
+            Cache &cache = lookup(msg._time);
+            size_t pos = 0;
+            for(auto &hole: cache._holes)
+            {
+                out.append(cache._text, pos, hole.first - pos);
+                appendFraction(out, msg._nsec, hole.second);
+                pos = hole.first;
+            }
+            out.append(cache._text, pos, std::string::npos);
+        }
+    private:
+        struct Cache
+        {
+            size_t _id = 0;
+            time_t _sec = -1;
+            std::string _text;                          // 已渲染的秒级部分
+            std::vector<std::pair<size_t, int>> _holes; // 小数部分在_text中的位置及位数
+        };
+        static size_t nextId()
+        {
+            static std::atomic<size_t> id(0);
+            return ++id;
+        }
+        // 将格式串拆分为若干strftime片段，每个片段之后可跟一个小数部分
+        void parseFormat()
+        {
+            std::string seg;
+            for(size_t i = 0; i < _format.size(); ++i)
+            {
+                if(_format[i] != '%' || i + 1 == _format.size())
+                {
+                    seg += _format[i];
+                    continue;
+                }
+                int digits = 0;
+                size_t j = i + 1;
+                if(_format[j] == 'N') digits = 9;
+                else if(_format[j] >= '1' && _format[j] <= '9' && j + 1 < _format.size() && _format[j + 1] == 'N')
+                    digits = _format[j++] - '0';
+                if(digits)
+                {
+                    _segments.push_back({seg, digits});
+                    seg.clear();
+                }
+                //其余转义（包括%%）原样交给strftime
+                else seg.append(_format, i, 2);
+                i = j;
+            }
+            _segments.push_back({seg, 0});
+        }
+        Cache &lookup(time_t sec)
+        {
+            thread_local std::array<Cache, TIME_CACHE_SIZE> caches;
+            thread_local size_t next = 0;
+            for(auto &cache: caches)
+            {
+                if(cache._id != _id) continue;
+                if(cache._sec != sec) render(cache, sec);
+                return cache;
+            }
+            Cache &cache = caches[next++ % TIME_CACHE_SIZE];
+            cache._id = _id;
+            render(cache, sec);
+            return cache;
+        }
+        void render(Cache &cache, time_t t)
         {
-            time_t t = msg._time;
             struct tm _tm;
             #ifdef _WIN32
             localtime_s(&_tm, &t);
             #else
             localtime_r(&t, &_tm);
             #endif
+            cache._sec = t;
+            cache._text.clear();
+            cache._holes.clear();
             char s[128];
-            strftime(s, 127, _format.c_str(), &_tm);
-            os << s;
+            for(auto &seg: _segments)
+            {
+                if(seg.first.size()) cache._text.append(s, strftime(s, 127, seg.first.c_str(), &_tm));
+                if(seg.second) cache._holes.push_back({cache._text.size(), seg.second});
+            }
+        }
+        static void appendFraction(std::string &out, uint32_t nsec, int digits)
+        {
+            static constexpr uint32_t POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+            uint32_t value = nsec / POW10[9 - digits];
+            char s[9];
+            for(int i = digits - 1; i >= 0; --i)
+            {
+                s[i] = '0' + value % 10;
+                value /= 10;
+            }
+            out.append(s, digits);
         }
     private:
         std::string _format;
+        size_t _id; // 用于线程本地缓存的唯一标识
+        std::vector<std::pair<std::string, int>> _segments;
     };
     class ThreadFormatItem: public FormatItem
     {
     public:
     ThreadFormatItem(const std::string &str){};
-        void format(std::ostream &os, const LogMsg &msg) override
+        void format(std::string &out, const LogMsg &msg) override
         {
-            os << msg._tid;
+            out += threadIdString(msg._tid);
         }
     };
     class NameFormatItem: public FormatItem
     {
     public:
     NameFormatItem(const std::string &str){};
-        void format(std::ostream &os, const LogMsg &msg) override
+        void format(std::string &out, const LogMsg &msg) override
         {
-            os << msg._name;
+            out += msg._name;
         }
     };
     class FileFormatItem: public FormatItem
     {
     public:
     FileFormatItem(const std::string &str){};
-        void format(std::ostream &os, const LogMsg &msg) override
+        void format(std::string &out, const LogMsg &msg) override
         {
-            os << msg._file;
+            out += msg._file;
         }
     };
     class PayLoadFormatItem: public FormatItem
     {
     public:
     PayLoadFormatItem(const std::string &str){};
-        void format(std::ostream &os, const LogMsg &msg) override
+        void format(std::string &out, const LogMsg &msg) override
         {
-            os << msg._payload;
+            out += msg._payload;
         }
     };
     class LevelFormatItem: public FormatItem
     {
     public:
     LevelFormatItem(const std::string &str){};
-        void format(std::ostream &os, const LogMsg &msg) override
+        void format(std::string &out, const LogMsg &msg) override
         {
-            os << toString(msg._level);
+            out += toStringView(msg._level);
         }
     };
     class TabFormatItem: public FormatItem
     {
     public:
     TabFormatItem(const std::string &str){};
-        void format(std::ostream &os, const LogMsg &msg) override
+        void format(std::string &out, const LogMsg &msg) override
         {
-            os << '\t';
+            out += '\t';
         }
     };
     class NLineFormatItem: public FormatItem
     {
     public:
     NLineFormatItem(const std::string &str){};
-        void format(std::ostream &os, const LogMsg &msg) override
+        void format(std::string &out, const LogMsg &msg) override
         {
-            os << '\n';
+            out += '\n';
         }
     };
     class OtherFormatItem: public FormatItem
     {
     public:
     OtherFormatItem(const std::string &str):message(str){};
-        void format(std::ostream &os, const LogMsg &msg) override
+        void format(std::string &out, const LogMsg &msg) override
         {
-            os << message;
+            out += message;
         }
     private:
         std::string message;
@@ -129,21 +239,26 @@ namespace log
         {
             assert(parsePattern());
         }
+        virtual ~Format() {}
         void format(std::ostream &out, LogMsg &msg)
         {
-            for(auto &item: _items)
-            {
-                item->format(out, msg);
-            }
+            std::string str;
+            format(str, msg);
+            out << str;
         };
         std::string format(LogMsg msg)
         {
-            std::stringstream ss;
+            std::string out;
+            format(out, msg);
+            return out;
+        }
+        // 将格式化结果追加到out之后，编译期格式化器会重写该接口
+        virtual void format(std::string &out, const LogMsg &msg)
+        {
             for(auto &item: _items)
             {
-                item->format(ss, msg);
+                item->format(out, msg);
             }
-            return ss.str();
         }
     private:
         bool parsePattern()
@@ -203,6 +318,8 @@ namespace log
                 }
                 v.push_back({key, value, true});
             }
+            //模式串以文本结尾时，剩余的文本信息同样需要push
+            if(text_inf.size()) v.push_back({"", text_inf, false});
             //将内容映射到_items中
             for(auto &tp: v)
             {
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <iostream>
+#include <string_view>
 
-namespace log
+// 整个库位于命名空间logsys：不能命名为log，<cmath>等标准头文件会在全局声明log(double)，与同名命名空间冲突
+namespace logsys
 {
     enum class Level
     {
@@ -14,6 +16,21 @@ namespace log
         FATAL,
         OFF
     };
+    const size_t LEVEL_COUNT = static_cast<size_t>(Level::OFF) + 1;
+
+    // 编译期最低等级，低于它的日志宏展开为空，参数既不会求值也不会参与编译，例如-DLOG_ACTIVE_LEVEL=LOG_LEVEL_INFO
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARNING 3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_FATAL 5
+#define LOG_LEVEL_OFF 6
+#ifndef LOG_ACTIVE_LEVEL
+#define LOG_ACTIVE_LEVEL LOG_LEVEL_DEBUG
+#endif
+    static_assert(LOG_LEVEL_DEBUG == static_cast<int>(Level::DEBUG) && LOG_LEVEL_OFF == static_cast<int>(Level::OFF));
+    // 该等级是否在编译期被启用
+    constexpr bool activeLevel(Level level) { return static_cast<int>(level) >= LOG_ACTIVE_LEVEL; }
 
     inline const char* toString(Level level)
     {
@@ -28,4 +45,12 @@ namespace log
             default:            return "UNKNOWN";
         }
     }
+
+    // 预先计算好的等级字符串表，避免格式化时再计算长度
+    inline constexpr std::string_view LEVEL_STRINGS[] = {"UNKNOWN", "DEBUG", "INFO", "WARNING", "ERROR", "FATAL", "OFF"};
+    inline std::string_view toStringView(Level level)
+    {
+        size_t idx = static_cast<size_t>(level);
+        return idx < LEVEL_COUNT ? LEVEL_STRINGS[idx] : LEVEL_STRINGS[0];
+    }
 }
\ No newline at end of file
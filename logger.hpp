@@ -5,64 +5,164 @@
 #include "sink.hpp"
 #include "message.hpp"
 #include "looper.hpp"
+#include "staging.hpp"
+#include "deferred.hpp"
+#include "binary.hpp"
+#include "ratelimit.hpp"
 #include <mutex>
 #include <format>
+#include <unordered_map>
 
 //建造者模式实现日志器的多种分类管理，并简化用户操作
-namespace log
+namespace logsys
 {
+    const size_t COLLAPSE_DEFAULT_INTERVAL = 10 * 1000; // 重复段最长多久（毫秒）输出一次汇总
+
     enum class LoggerType
     {
         LOGGER_SYNC = 0,
         LOGGER_ASYNC
     };
+    // 异步日志器配置
+    struct AsyncOption
+    {
+        OverflowOption _overflow;                          // 缓冲区满时的处理策略
+        LooperType _looper_type = LooperType::LOOPER_BUFFER;
+        size_t _ring_capacity = RING_DEFAULT_CAPACITY;     // 环形队列槽位数
+        bool _staging = false;                             // 是否启用线程本地暂存区
+        size_t _staging_size = STAGING_DEFAULT_SIZE;       // 暂存区提交阈值
+        size_t _staging_interval = STAGING_DEFAULT_INTERVAL; // 暂存区最长提交间隔（毫秒）
+        bool _deferred = false;                            // 是否将格式化推迟到异步线程
+        BackendPool::ptr _pool;                            // 共享的后台线程池，为空表示独占线程（仅双缓冲区使用）
+        size_t _buffer_size = BUFFER_DEFAULT_SIZE;         // 双缓冲区每块的容量，实际内存按需分配
+        bool _collapse = false;                            // 异步线程合并连续重复的日志，需要延迟格式化
+        size_t _collapse_interval = COLLAPSE_DEFAULT_INTERVAL; // 重复段持续该时间（毫秒）后输出一次汇总，0表示不限
+        size_t _collapse_max = 0;                          // 累计该条数的重复后输出一次汇总，0表示不限
+    };
     class Logger
     {
     public:
         using ptr = std::shared_ptr<Logger>;
         Logger(const std::string &logger_name, Format::ptr format,
                std::vector<LogSink::ptr> &sinks, Level limit_level = Level::DEBUG)
-            : _logger_name(logger_name), _format(format), _sinks(sinks), _limit_level(limit_level) {}
+            : _logger_name(logger_name), _sinks(sinks), _format(format), _limit_level(limit_level)
+        {
+            for (auto &sink : _sinks)
+            {
+                _async_sinks.push_back(std::dynamic_pointer_cast<AsyncLogSink>(sink).get());
+                // 接收记录的落地方向需要原始参数，强制启用延迟格式化
+                if (sink->acceptRecords()) _deferred = true;
+            }
+        }
+        virtual ~Logger()
+        {
+            if (_timer) _timer->cancel(this);
+        }
         template <class... Args>
-        void debug(const std::string &filename, size_t line, const char *fmt, Args... args)
+        void debug(std::string_view filename, size_t line, const char *fmt, const Args &...args)
         {
             // 先检查该等级是否需要落地
-            if (Level::DEBUG < _limit_level)
+            if (!shouldLog(Level::DEBUG))
                 return;
-            log(Level::DEBUG, std::move(filename), line, fmt, args...);
+            log(Level::DEBUG, filename, line, fmt, args...);
         }
         template <class... Args>
-        void info(const std::string &filename, size_t line, const char *fmt, Args... args)
+        void info(std::string_view filename, size_t line, const char *fmt, const Args &...args)
         {
             // 先检查该等级是否需要落地
-            if (Level::INFO < _limit_level)
+            if (!shouldLog(Level::INFO))
                 return;
-            log(Level::INFO, std::move(filename), line, fmt, args...);
+            log(Level::INFO, filename, line, fmt, args...);
         }
         template <class... Args>
-        void warning(const std::string &filename, size_t line, const char *fmt, Args... args)
+        void warning(std::string_view filename, size_t line, const char *fmt, const Args &...args)
         {
             // 先检查该等级是否需要落地
-            if (Level::WARNING < _limit_level)
+            if (!shouldLog(Level::WARNING))
                 return;
-            log(Level::WARNING, std::move(filename), line, fmt, args...);
+            log(Level::WARNING, filename, line, fmt, args...);
         }
         template <class... Args>
-        void error(const std::string &filename, size_t line, const char *fmt, Args... args)
+        void error(std::string_view filename, size_t line, const char *fmt, const Args &...args)
         {
             // 先检查该等级是否需要落地
-            if (Level::ERROR < _limit_level)
+            if (!shouldLog(Level::ERROR))
                 return;
-            log(Level::ERROR, std::move(filename), line, fmt, args...);
+            log(Level::ERROR, filename, line, fmt, args...);
         }
         template <class... Args>
-        void fatal(const std::string &filename, size_t line, const char *fmt, Args... args)
+        void fatal(std::string_view filename, size_t line, const char *fmt, const Args &...args)
         {
             // 先检查该等级是否需要落地
-            if (Level::FATAL < _limit_level)
+            if (!shouldLog(Level::FATAL))
+                return;
+            log(Level::FATAL, filename, line, fmt, args...);
+        }
+        // 日志宏使用：格式串在编译期检查，等级检查由宏在参数求值之前完成
+        template <class... Args>
+        void log(const CallSite &site, std::format_string<Args...> fmt, Args &&...args)
+        {
+            if (_deferred)
+            {
+                std::string &record = recordBuffer();
+                record.clear();
+                if constexpr ((Deferrable<Args> && ...))
+                    DeferredCodec::encode(record, site, args...);
+                else
+                {
+                    std::vector<LogField> fields;
+                    collectFields(fields, args...);
+                    std::string &payload = payloadBuffer();
+                    std::format_to(std::back_inserter(payload), fmt, std::forward<Args>(args)...);
+                    DeferredCodec::encodeFormatted(record, site._level, site._file, site._line, payload, fields);
+                }
+                logManage(record, site._level);
+                return;
+            }
+            std::string &payload = payloadBuffer();
+            std::format_to(std::back_inserter(payload), fmt, std::forward<Args>(args)...);
+            LogMsg lmsg(_logger_name, site._file, site._line, payload, site._level);
+            collectFields(lmsg._fields, args...);
+            logFormatted(lmsg);
+        }
+        // 限流宏使用：suppressed为该调用点上次输出以来被拦下的条数，不为0时在消息末尾注明并附加suppressed字段
+        template <class... Args>
+        void log(const CallSite &site, size_t suppressed, std::format_string<Args...> fmt, Args &&...args)
+        {
+            if (suppressed == 0)
+                return log(site, fmt, std::forward<Args>(args)...);
+            std::vector<LogField> fields;
+            collectFields(fields, args...);
+            fields.push_back({"suppressed", std::to_string(suppressed), false});
+            std::string &payload = payloadBuffer();
+            std::format_to(std::back_inserter(payload), fmt, std::forward<Args>(args)...);
+            std::format_to(std::back_inserter(payload), " [{} suppressed]", suppressed);
+            if (_deferred)
+            {
+                std::string &record = recordBuffer();
+                record.clear();
+                DeferredCodec::encodeFormatted(record, site._level, site._file, site._line, payload, fields);
+                logManage(record, site._level);
                 return;
-            log(Level::FATAL, std::move(filename), line, fmt, args...);
+            }
+            LogMsg lmsg(_logger_name, site._file, site._line, payload, site._level);
+            lmsg._fields = std::move(fields);
+            logFormatted(lmsg);
+        }
+        // 等级检查只需一次relaxed读取：等级只是开关，不需要与其他数据同步；编译期被关闭的等级直接返回false
+        bool shouldLog(Level level) const
+        {
+            return activeLevel(level) && level >= _limit_level.load(std::memory_order_relaxed);
         }
+        // 运行时调整日志等级，线程安全，其他线程的下一次检查即可看到新等级
+        void setLevel(Level level) { _limit_level.store(level, std::memory_order_relaxed); }
+        Level level() const { return _limit_level.load(std::memory_order_relaxed); }
+        const std::string &name() const { return _logger_name; }
+        // 将已产生的日志全部交给落地方向
+        virtual void flush() { flushSinks(); }
+        // 因缓冲区溢出而被丢弃的日志条数
+        virtual size_t dropped(Level level) { return 0; }
+        virtual size_t dropped() { return 0; }
 
     public:
         //建造者实现，注：不需要指挥者，因为指挥者主要用于确定建造次序的，这里的日志器实现并不需要次序性
@@ -71,9 +171,9 @@ namespace log
         {
         public:
             Builder(Level limit_level = Level::DEBUG, bool check_space = true)
-                :_limit_level(limit_level),
-                _check_space(check_space)
+                :_limit_level(limit_level)
             {
+                buildCheckWay(check_space);
             }
             void buildLoggerName(const std::string &name)
             {
@@ -101,7 +201,47 @@ namespace log
                 auto sink = sinkCreate<T>(std::forward<Args>(args)...);
                 _sinks.push_back(sink);
             }
-            void buildCheckWay(bool check_space) { _check_space = check_space; }
+            // 添加已创建好的落地方向（如已设置持久化策略的落地方向）
+            void buildSink(const LogSink::ptr &sink)
+            {
+                _sinks.push_back(sink);
+            }
+            void buildCheckWay(bool check_space)
+            {
+                _async_option._overflow._policy = check_space ? OverflowPolicy::BLOCK : OverflowPolicy::GROW;
+            }
+            void buildOverflowPolicy(OverflowPolicy policy, Level drop_level = Level::WARNING, size_t timeout_ms = 0)
+            {
+                _async_option._overflow = {policy, drop_level, timeout_ms};
+            }
+            void buildLooperType(LooperType type, size_t ring_capacity = RING_DEFAULT_CAPACITY)
+            {
+                _async_option._looper_type = type;
+                _async_option._ring_capacity = ring_capacity;
+            }
+            // 双缓冲区的容量，写满后按溢出策略处理；低流量的日志器实际只占用几KB
+            // 不足BUFFER_INITIAL_SIZE时按BUFFER_INITIAL_SIZE处理（容量为0时扩容会死循环）
+            void buildBufferSize(size_t size) { _async_option._buffer_size = std::max(size, BUFFER_INITIAL_SIZE); }
+            void buildStaging(size_t staging_size = STAGING_DEFAULT_SIZE, size_t interval_ms = STAGING_DEFAULT_INTERVAL)
+            {
+                _async_option._staging = true;
+                _async_option._staging_size = staging_size;
+                _async_option._staging_interval = interval_ms;
+            }
+            void buildDeferredFormat(bool deferred = true) { _async_option._deferred = deferred; }
+            // 异步线程合并连续重复的日志（等级、调用点与消息相同）：第一条立即输出，其后的重复在出现不同的日志、
+            // flush或日志器销毁时汇总为一条，附带重复次数与最后一条的时间；连续段可以跨越多批数据
+            // 重复持续interval_ms毫秒或累计max_repeats条时先输出一次汇总再继续计数，持续的错误风暴不会长时间没有输出
+            // 重复判断基于原始记录，启用后自动使用延迟格式化
+            void buildCollapseDuplicates(bool collapse = true, size_t interval_ms = COLLAPSE_DEFAULT_INTERVAL,
+                                         size_t max_repeats = 0)
+            {
+                _async_option._collapse = collapse;
+                _async_option._collapse_interval = interval_ms;
+                _async_option._collapse_max = max_repeats;
+            }
+            // 与其他异步日志器共享后台线程，环形队列始终独占线程
+            void buildBackendPool(const BackendPool::ptr &pool) { _async_option._pool = pool; }
             virtual ptr build() = 0;
 
         protected:
@@ -109,35 +249,195 @@ namespace log
             std::vector<LogSink::ptr> _sinks;
             Format::ptr _format;
             std::atomic<Level> _limit_level;
-            LoggerType _type;
-            bool _check_space; //异步日志器使用
+            LoggerType _type = LoggerType::LOGGER_SYNC;
+            AsyncOption _async_option; //异步日志器使用
         };
 
     protected:
         template <class... Args>
-        void log(Level level, const std::string &filename, size_t line, const char *fmt, Args const... args)
+        void log(Level level, std::string_view filename, size_t line, const char *fmt, const Args &...args)
+        {
+            if (_deferred)
+            {
+                logDeferred(level, filename, line, fmt, args...);
+                return;
+            }
+            std::string &payload = payloadBuffer();
+            formatPayload(payload, fmt, args...);
+            LogMsg lmsg(_logger_name, filename, line, payload, level);
+            collectFields(lmsg._fields, args...);
+            logFormatted(lmsg);
+        }
+        void logFormatted(LogMsg &lmsg)
+        {
+            //线程本地缓冲区复用已有容量，稳定状态下格式化不再分配内存
+            thread_local std::string msg;
+            msg.clear();
+            _format->format(msg, lmsg);
+            logManage(msg, lmsg._level);
+        }
+        static std::string &recordBuffer()
+        {
+            thread_local std::string record;
+            return record;
+        }
+        // 消息直接格式化到线程本地缓冲区中，返回前已清空
+        static std::string &payloadBuffer()
+        {
+            thread_local std::string payload;
+            payload.clear();
+            return payload;
+        }
+        template <class... Args>
+        static void formatPayload(std::string &out, const char *fmt, Args const &...args)
         {
-            std::string msg;
             try
             {
-                msg = std::vformat(fmt, std::make_format_args(args...));
+                std::vformat_to(std::back_inserter(out), fmt, std::make_format_args(args...));
             }
             catch (const std::format_error &e)
             {
-                msg = "Invalid log format: " + std::string(fmt);
+                out.assign("Invalid log format: ").append(fmt);
             }
-            // std::string msg = std::vformat(fmt, std::make_format_args(std::forward<Args>(args)...));
-            LogMsg lmsg(_logger_name, filename, line, std::move(msg), level);
-            std::stringstream ss;
-            _format->format(ss, lmsg);
-            logManage(ss.str());
         }
-        virtual void logManage(const std::string &msg) = 0;
+        // 只序列化原始参数，格式化由异步线程完成；含有无法延迟的参数时，仅在当前线程生成消息
+        template <class... Args>
+        void logDeferred(Level level, std::string_view filename, size_t line, const char *fmt, Args const &...args)
+        {
+            std::string &record = recordBuffer();
+            record.clear();
+            if constexpr ((Deferrable<Args> && ...))
+                DeferredCodec::encode(record, level, filename, line, fmt, args...);
+            else
+            {
+                std::vector<LogField> fields;
+                collectFields(fields, args...);
+                std::string &payload = payloadBuffer();
+                formatPayload(payload, fmt, args...);
+                DeferredCodec::encodeFormatted(record, level, filename, line, payload, fields);
+            }
+            logManage(record, level);
+        }
+        virtual void logManage(const std::string &msg, Level level) = 0;
+        // 将一批数据写入所有落地方向，每个落地方向写完后按各自的持久化策略同步（组提交）
+        // 独立落地只拿到一份共享的数据，整批数据最多拷贝一次
+        void writeSinks(const Fragment *frags, size_t n, Level level)
+        {
+            size_t len = 0;
+            for (size_t i = 0; i < n; ++i) len += frags[i]._len;
+            AsyncLogSink::Data shared;
+            for (size_t i = 0; i < _sinks.size(); ++i)
+            {
+                if (_sinks[i]->acceptRecords()) continue; // 已由writeRecords交付原始记录
+                if (_async_sinks[i])
+                {
+                    if (!shared)
+                    {
+                        auto data = std::make_shared<std::string>();
+                        data->reserve(len);
+                        for (size_t j = 0; j < n; ++j) data->append(frags[j]._data, frags[j]._len);
+                        shared = std::move(data);
+                    }
+                    _async_sinks[i]->push(shared, level);
+                    continue;
+                }
+                _sinks[i]->logBatch(frags, n);
+                _sinks[i]->commit(len, level);
+            }
+        }
+        // 一批延迟格式化记录：接收记录的落地方向直接拿到原始记录，其余落地方向拿到渲染后的文本
+        void writeRecords(const Fragment *frags, size_t n, Level level)
+        {
+            size_t len = 0;
+            for (size_t i = 0; i < n; ++i) len += frags[i]._len;
+            bool text = false;
+            for (auto &sink : _sinks)
+            {
+                if (!sink->acceptRecords())
+                {
+                    text = true;
+                    continue;
+                }
+                sink->logRecords(frags, n, _logger_name);
+                sink->commit(len, level);
+            }
+            if (!text) return;
+            for (size_t i = 0; i < n; ++i)
+                render(frags[i]);
+            Fragment frag{_render.data(), _render.size()};
+            writeSinks(&frag, 1, level);
+            _render.clear();
+        }
+        // 将延迟格式化记录渲染为文本，整批渲染完毕后再统一落地
+        void render(const Fragment &frag)
+        {
+            std::string &payload = _render_payload;
+            DeferredCodec::foreach(frag._data, frag._len,
+                [&](const DeferredRecord &rec, std::string_view file, std::string_view fmt, const char *args) {
+                    renderPayload(payload, rec, fmt, args);
+                    LogMsg msg(_logger_name, file, rec._line, payload, rec._level,
+                               rec._time, rec._nsec, rec._tid);
+                    if (rec._decode == nullptr) DeferredCodec::getFields(rec, args, msg._fields);
+                    _format->format(_render, msg);
+                });
+        }
+        static void renderPayload(std::string &payload, const DeferredRecord &rec, std::string_view fmt, const char *args)
+        {
+            payload.clear();
+            if (rec._decode == nullptr) payload.assign(fmt);
+            else
+            {
+                try { rec._decode(args, fmt, payload); }
+                catch (const std::format_error &e) { payload.assign("Invalid log format: ").append(fmt); }
+            }
+        }
+        // 有定时工作（落地方向按时间同步等）时注册后台定时器，保证日志器空闲后也能按时完成（调用者需持有_mtx）
+        // 只有比已注册的时间更早时才需要重新注册
+        void armTimer()
+        {
+            auto deadline = timerDeadline();
+            if (deadline >= _timer_deadline) return;
+            if (!_timer) _timer = BackendTimer::getInstance();
+            _timer_deadline = deadline;
+            _timer->schedule(this, &Logger::timerCallback, deadline);
+        }
+        // 定时线程需要介入的最早时刻，默认只有落地方向的按时间同步（调用者需持有_mtx）
+        virtual BackendTimer::TimePoint timerDeadline() const { return syncDeadline(); }
+        // 定时线程回调中持有_mtx时调用，处理派生类到期的定时工作；派生类重写时需在析构中先取消定时器
+        virtual void onTimer() {}
+        BackendTimer::TimePoint syncDeadline() const
+        {
+            auto deadline = BackendTimer::TimePoint::max();
+            for (auto &sink : _sinks) deadline = std::min(deadline, sink->syncDeadline());
+            return deadline;
+        }
+        // 定时线程回调：与写入落地方向的线程互斥地处理到期的工作，返回下一次需要检查的时间
+        static BackendTimer::TimePoint timerCallback(void *arg)
+        {
+            Logger *logger = static_cast<Logger *>(arg);
+            std::unique_lock<std::mutex> lock(logger->_mtx);
+            logger->onTimer();
+            for (auto &sink : logger->_sinks) sink->syncIfDue();
+            logger->_timer_deadline = logger->timerDeadline();
+            return logger->_timer_deadline;
+        }
+        // 等待独立落地的队列清空
+        void flushSinks()
+        {
+            for (auto sink : _async_sinks)
+                if (sink) sink->flush();
+        }
         std::mutex _mtx;
         std::string _logger_name;
         std::vector<LogSink::ptr> _sinks;
         Format::ptr _format;
         std::atomic<Level> _limit_level;
+        bool _deferred = false; // 缓冲区中存放的是延迟格式化记录而非文本
+        std::string _render; // 延迟格式化模式下渲染后的文本
+        std::string _render_payload; // 渲染时复用的消息缓冲区
+        std::vector<AsyncLogSink *> _async_sinks; // 与_sinks一一对应，非独立落地为空
+        BackendTimer::ptr _timer;  // 首次有定时工作时获取
+        BackendTimer::TimePoint _timer_deadline = BackendTimer::TimePoint::max(); // 已在定时器中注册的时间，由_mtx保护
     };
 
     //同步日志器
@@ -149,12 +449,14 @@ namespace log
             : Logger(logger_name, format, sinks, limit_level) {}
 
     private:
-        void logManage(const std::string &msg) override
+        void logManage(const std::string &msg, Level level) override
         {
             std::unique_lock<std::mutex> lock(_mtx);
             if (_sinks.empty()) { return; }
-            for (auto &sink : _sinks)
-                sink->log(msg.c_str(), msg.size());
+            Fragment frag{msg.c_str(), msg.size()};
+            if (_deferred) writeRecords(&frag, 1, level);
+            else writeSinks(&frag, 1, level);
+            armTimer();
         }
     };
 
@@ -163,27 +465,185 @@ namespace log
     {
     public:
         AsyncLogger(const std::string &logger_name, Format::ptr format,
-                   std::vector<LogSink::ptr> &sinks, Level limit_level = Level::DEBUG, bool check_space = true)
-            : Logger(logger_name, format, sinks, limit_level),
-            _looper(std::make_shared<AsyncLooper>(std::bind(&AsyncLogger::logSink, this, std::placeholders::_1), check_space)){}
+                   std::vector<LogSink::ptr> &sinks, Level limit_level = Level::DEBUG,
+                   const AsyncOption &option = AsyncOption())
+            : Logger(logger_name, format, sinks, limit_level)
+        {
+            if (option._deferred || option._collapse) _deferred = true;
+            _collapse = option._collapse;
+            _collapse_interval = std::chrono::milliseconds(option._collapse_interval);
+            _collapse_max = option._collapse_max;
+            auto cb = std::bind(&AsyncLogger::logSink, this, std::placeholders::_1, std::placeholders::_2,
+                                std::placeholders::_3);
+            if (option._looper_type == LooperType::LOOPER_RING)
+                _looper = std::make_shared<RingLooper>(cb, option._ring_capacity, option._overflow);
+            else
+                _looper = std::make_shared<AsyncLooper>(cb, option._overflow, option._pool, option._buffer_size);
+            if (option._staging)
+                _stager = std::make_shared<Stager>(_looper, option._staging_size, option._staging_interval);
+        }
+        ~AsyncLogger()
+        {
+            //先停止后台线程，保证所有记录都已交给logSink，再输出未结束的重复段
+            _stager.reset();
+            _looper.reset();
+            if (_collapse) writeRun();
+            //此后不再有写入；定时回调会调用派生类的onTimer，必须在派生类析构前取消
+            if (_timer) _timer->cancel(this);
+        }
+        void flush() override
+        {
+            if (_stager) _stager->flush();
+            _looper->flush();
+            if (_collapse) writeRun();
+            flushSinks();
+        }
+        size_t dropped(Level level) override { return _looper->dropped().count(level); }
+        size_t dropped() override { return _looper->dropped().total(); }
 
     private:
-        
-        void logManage(const std::string &msg) override
+        // 生产者线程只负责将格式化后的日志放入缓冲区，落地操作交由异步线程完成
+        void logManage(const std::string &msg, Level level) override
         {
-            std::unique_lock<std::mutex> lock(_mtx);
-            for (auto &sink : _sinks)
-                sink->log(msg.c_str(), msg.size());
+            if (_stager) _stager->push(msg.c_str(), msg.size(), level);
+            else _looper->push(msg.c_str(), msg.size(), level);
         }
 
-        void logSink(Buffer &buffer)
+        // 异步线程回调：将整批数据一次性交给各个落地方向，整批写完后再按持久化策略同步（组提交）
+        void logSink(const Fragment *frags, size_t n, Level level)
         {
+            //与定时线程的按时间同步互斥，正常情况下不会有竞争
+            std::unique_lock<std::mutex> lock(_mtx);
             if (_sinks.empty()) { return; }
-            for(auto &sink: _sinks)
-                sink->log(buffer.begin(), buffer.readAbleSize());
+            if (_collapse)
+            {
+                collapse(frags, n);
+                writeCollapsed(level);
+            }
+            else if (_deferred) writeRecords(frags, n, level);
+            else writeSinks(frags, n, level);
+            armTimer();
+        }
+        // 合并连续重复的记录，输出放在_collapsed中：每段的第一条原样保留，重复的记录只计数，
+        // 段结束或达到时间、条数上限时追加汇总记录；批末尾未结束的段拷贝到_run，由下一批、定时器、flush或析构继续处理
+        void collapse(const Fragment *frags, size_t n)
+        {
+            auto now = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < n; ++i)
+            {
+                const char *end = frags[i]._data + frags[i]._len;
+                for (const char *p = frags[i]._data; p < end;)
+                {
+                    uint32_t size;
+                    std::memcpy(&size, p, sizeof(size));
+                    if (_run_first && DeferredCodec::sameContent(_run_first, p))
+                    {
+                        std::memcpy(&_run_last, p, sizeof(_run_last));
+                        if (++_repeats == _collapse_max || runExpired(now)) splitRun(now);
+                    }
+                    else
+                    {
+                        closeRun();
+                        _run_first = p;
+                        _run_start = now;
+                        _collapsed.append(p, size);
+                    }
+                    p += size;
+                }
+            }
+            //批数据在回调返回后会被复用
+            if (_run_first && _run_first != _run.data())
+            {
+                uint32_t size;
+                std::memcpy(&size, _run_first, sizeof(size));
+                _run.assign(_run_first, size);
+                _run_first = _run.data();
+            }
+        }
+        // 结束当前段：有重复时向_collapsed追加汇总记录
+        void closeRun()
+        {
+            if (_repeats) appendRepeated();
+            _run_first = nullptr;
+            _repeats = 0;
+        }
+        // 段达到上限：输出目前为止的汇总，段继续，之后的重复重新计数
+        void splitRun(std::chrono::steady_clock::time_point now)
+        {
+            appendRepeated();
+            _repeats = 0;
+            _run_start = now;
+        }
+        bool runExpired(std::chrono::steady_clock::time_point now) const
+        {
+            return _collapse_interval.count() && now - _run_start >= _collapse_interval;
+        }
+        BackendTimer::TimePoint timerDeadline() const override
+        {
+            auto deadline = syncDeadline();
+            if (_repeats && _collapse_interval.count()) deadline = std::min(deadline, _run_start + _collapse_interval);
+            return deadline;
+        }
+        // 日志器空闲时，由定时器输出持续时间达到上限的段的汇总
+        void onTimer() override
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (_sinks.empty() || _repeats == 0 || !runExpired(now)) return;
+            Level level = _run_last._level;
+            splitRun(now);
+            writeCollapsed(level);
+        }
+        void writeCollapsed(Level level)
+        {
+            if (_collapsed.empty()) return;
+            Fragment frag{_collapsed.data(), _collapsed.size()};
+            writeRecords(&frag, 1, level);
+            _collapsed.clear();
+        }
+        // flush与析构时结束当前段，此时后台线程没有未处理的数据
+        void writeRun()
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            if (_sinks.empty() || _repeats == 0) return;
+            Level level = _run_last._level;
+            closeRun();
+            writeCollapsed(level);
+            armTimer();
+        }
+        // 汇总记录：调用点与消息取第一条，时间与线程取最后一条，消息末尾注明第一条之后的重复次数，并附加相应字段
+        void appendRepeated()
+        {
+            std::string &last_time = _collapse_time;
+            last_time.clear();
+            _last_time.format(last_time, LogMsg({}, {}, 0, {}, _run_last._level, _run_last._time, _run_last._nsec, _run_last._tid));
+            uint32_t size;
+            std::memcpy(&size, _run_first, sizeof(size));
+            DeferredCodec::foreach(_run_first, size,
+                [&](const DeferredRecord &rec, std::string_view file, std::string_view fmt, const char *args) {
+                    std::string &payload = _render_payload;
+                    renderPayload(payload, rec, fmt, args);
+                    std::format_to(std::back_inserter(payload), " [repeated {} times, last at {}]", _repeats, last_time);
+                    std::vector<LogField> fields;
+                    if (rec._decode == nullptr) DeferredCodec::getFields(rec, args, fields);
+                    fields.push_back({"repeated", std::to_string(_repeats), false});
+                    fields.push_back({"last_time", last_time, true});
+                    DeferredCodec::encodeFormatted(_collapsed, _run_last, file, payload, fields);
+                });
         }
     private:
-        AsyncLooper::ptr _looper;
+        bool _collapse = false;
+        std::string _collapsed;     // 合并后的记录
+        const char *_run_first = nullptr; // 当前段的第一条记录，位于当前批数据或_run中
+        std::string _run;           // 跨批的段的第一条记录
+        DeferredRecord _run_last{}; // 当前段最后一条重复记录的头部
+        size_t _repeats = 0;        // 当前段第一条（或上次汇总）之后的重复次数
+        std::chrono::steady_clock::time_point _run_start; // 当前段开始（或上次汇总）的时间
+        std::chrono::milliseconds _collapse_interval{0};
+        size_t _collapse_max = 0;
+        std::string _collapse_time; // 最后一条重复记录的时间
+        TimeFormatItem _last_time{"%Y-%m-%d %H:%M:%S.%6N"};
+        Looper::ptr _looper;
+        Stager::ptr _stager; // 在_looper之前析构，保证暂存数据能够提交
     };
     // class AsyncLogger : public Logger
     // {
@@ -195,6 +655,12 @@ namespace log
     {
     public:
         Logger::ptr build() override
+        {
+            return buildLogger();
+        }
+
+    protected:
+        Logger::ptr buildLogger()
         {
             // 空处理
             if (_logger_name.empty())
@@ -214,7 +680,167 @@ namespace log
             {
                 return std::make_shared<SyncLogger>(_logger_name, _format, _sinks, _limit_level);
             }
-            return std::make_shared<AsyncLogger>(_logger_name, _format, _sinks, _limit_level, _check_space);
+            return std::make_shared<AsyncLogger>(_logger_name, _format, _sinks, _limit_level, _async_option);
         }
     };
-};
\ No newline at end of file
+
+    // 全局日志器管理：按名称注册与查找，单例
+    // 查找是读多写少的操作，注册时复制整张表再原子地替换（写时复制），查找只需一次原子读取，不加锁
+    // 被替换的旧表不会释放（注册次数很少），保证正在查找的线程始终访问有效的表
+    class LoggerManager
+    {
+    public:
+        static LoggerManager &getInstance()
+        {
+            static LoggerManager manager;
+            return manager;
+        }
+        // 同名日志器已存在时返回false
+        bool addLogger(const Logger::ptr &logger)
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            const LoggerMap *cur = _loggers.load(std::memory_order_relaxed);
+            if (cur->count(logger->name())) return false;
+            auto next = std::make_unique<LoggerMap>(*cur);
+            next->emplace(logger->name(), logger);
+            _loggers.store(next.get(), std::memory_order_release);
+            _versions.push_back(std::move(next));
+            return true;
+        }
+        bool hasLogger(const std::string &name) const
+        {
+            return _loggers.load(std::memory_order_acquire)->count(name) != 0;
+        }
+        // 不存在时返回空
+        Logger::ptr getLogger(const std::string &name) const
+        {
+            const LoggerMap *cur = _loggers.load(std::memory_order_acquire);
+            auto it = cur->find(name);
+            return it == cur->end() ? nullptr : it->second;
+        }
+        Logger::ptr rootLogger() const { return _root; }
+        // 设置共享后台线程池的线程数，需在第一次使用backendPool()之前调用
+        void setBackendThreads(size_t threads)
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _backend_threads = threads;
+        }
+        // 全局日志器默认使用的后台线程池，第一次使用时创建
+        BackendPool::ptr backendPool()
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            if (!_pool) _pool = std::make_shared<BackendPool>(_backend_threads);
+            return _pool;
+        }
+
+    private:
+        using LoggerMap = std::unordered_map<std::string, Logger::ptr>;
+        LoggerManager() : _backend_threads(BACKEND_POOL_DEFAULT_THREADS)
+        {
+            _versions.push_back(std::make_unique<LoggerMap>());
+            _loggers.store(_versions.back().get(), std::memory_order_release);
+            std::unique_ptr<LocalLoggerBuilder> builder(new LocalLoggerBuilder());
+            builder->buildLoggerName("root");
+            builder->buildType(LoggerType::LOGGER_SYNC);
+            _root = builder->build();
+            addLogger(_root);
+        }
+        LoggerManager(const LoggerManager &) = delete;
+        LoggerManager &operator=(const LoggerManager &) = delete;
+
+    private:
+        std::mutex _mtx;                                  // 只用于注册与创建线程池
+        size_t _backend_threads;
+        BackendPool::ptr _pool;                           // 需在日志器之后析构
+        std::vector<std::unique_ptr<LoggerMap>> _versions; // 所有版本的表，最后一个为当前版本
+        std::atomic<const LoggerMap *> _loggers;
+        Logger::ptr _root;
+    };
+
+    // 全局日志器建造者：构建后注册到LoggerManager，异步日志器默认共享全局的后台线程池
+    class GlobalLoggerBuilder : public LocalLoggerBuilder
+    {
+    public:
+        Logger::ptr build() override
+        {
+            if (_type == LoggerType::LOGGER_ASYNC && !_async_option._pool)
+                _async_option._pool = LoggerManager::getInstance().backendPool();
+            Logger::ptr logger = buildLogger();
+            if (!LoggerManager::getInstance().addLogger(logger))
+                throw std::runtime_error("日志器" + _logger_name + "已存在，无法重复注册");
+            return logger;
+        }
+    };
+
+    // 获取全局日志器，不存在时返回空
+    inline Logger::ptr getLogger(const std::string &name) { return LoggerManager::getInstance().getLogger(name); }
+    inline Logger::ptr rootLogger() { return LoggerManager::getInstance().rootLogger(); }
+};
+
+// 日志宏：等级不满足时不会对任何参数求值，调用点信息在编译期生成，格式串在编译期检查
+// 低于LOG_ACTIVE_LEVEL的等级宏展开为空，整条语句在编译期被移除
+#define LOG_LOG(logger, level, fmt, ...)                                                     \
+    do                                                                                       \
+    {                                                                                        \
+        auto &&_log_logger = (logger);                                                       \
+        if (_log_logger->shouldLog(level))                                                   \
+        {                                                                                    \
+            static constexpr ::logsys::CallSite _log_site{__FILE__, __func__, __LINE__, level, fmt}; \
+            _log_logger->log(_log_site, fmt __VA_OPT__(, ) __VA_ARGS__);                    \
+        }                                                                                    \
+    } while (0)
+// 限流日志宏：limiter为限流器表达式，每个调用点持有一个独立的静态限流器，被拦下的日志不会格式化
+// 例：LOG_LIMITED(logger, logsys::Level::ERROR, logsys::EveryN(10, 1000), "read failed: {}", err);
+#define LOG_LIMITED(logger, level, limiter, fmt, ...)                                        \
+    do                                                                                       \
+    {                                                                                        \
+        auto &&_log_logger = (logger);                                                       \
+        if (_log_logger->shouldLog(level))                                                   \
+        {                                                                                    \
+            static auto _log_limiter = limiter;                                              \
+            size_t _log_suppressed;                                                          \
+            if (_log_limiter.acquire(_log_suppressed))                                       \
+            {                                                                                \
+                static constexpr ::logsys::CallSite _log_site{__FILE__, __func__, __LINE__, level, fmt}; \
+                _log_logger->log(_log_site, _log_suppressed, fmt __VA_OPT__(, ) __VA_ARGS__); \
+            }                                                                                \
+        }                                                                                    \
+    } while (0)
+// 令牌桶：平均每秒per_second条，最多burst条突发
+#define LOG_RATE_LIMITED(logger, level, per_second, burst, fmt, ...) \
+    LOG_LIMITED(logger, level, ::logsys::TokenBucket(per_second, burst), fmt __VA_OPT__(, ) __VA_ARGS__)
+// 前first条全部输出，之后每every条输出一条
+#define LOG_EVERY_N(logger, level, first, every, fmt, ...) \
+    LOG_LIMITED(logger, level, ::logsys::EveryN(first, every), fmt __VA_OPT__(, ) __VA_ARGS__)
+// 按probability的概率输出
+#define LOG_SAMPLED(logger, level, probability, fmt, ...) \
+    LOG_LIMITED(logger, level, ::logsys::Sampler(probability), fmt __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_DISABLED(logger, fmt, ...) \
+    do                                 \
+    {                                  \
+    } while (0)
+#if LOG_ACTIVE_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(logger, fmt, ...) LOG_LOG(logger, ::logsys::Level::DEBUG, fmt __VA_OPT__(, ) __VA_ARGS__)
+#else
+#define LOG_DEBUG(logger, fmt, ...) LOG_DISABLED(logger, fmt)
+#endif
+#if LOG_ACTIVE_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(logger, fmt, ...) LOG_LOG(logger, ::logsys::Level::INFO, fmt __VA_OPT__(, ) __VA_ARGS__)
+#else
+#define LOG_INFO(logger, fmt, ...) LOG_DISABLED(logger, fmt)
+#endif
+#if LOG_ACTIVE_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(logger, fmt, ...) LOG_LOG(logger, ::logsys::Level::WARNING, fmt __VA_OPT__(, ) __VA_ARGS__)
+#else
+#define LOG_WARNING(logger, fmt, ...) LOG_DISABLED(logger, fmt)
+#endif
+#if LOG_ACTIVE_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(logger, fmt, ...) LOG_LOG(logger, ::logsys::Level::ERROR, fmt __VA_OPT__(, ) __VA_ARGS__)
+#else
+#define LOG_ERROR(logger, fmt, ...) LOG_DISABLED(logger, fmt)
+#endif
+#if LOG_ACTIVE_LEVEL <= LOG_LEVEL_FATAL
+#define LOG_FATAL(logger, fmt, ...) LOG_LOG(logger, ::logsys::Level::FATAL, fmt __VA_OPT__(, ) __VA_ARGS__)
+#else
+#define LOG_FATAL(logger, fmt, ...) LOG_DISABLED(logger, fmt)
+#endif
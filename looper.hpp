@@ -4,36 +4,383 @@
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <deque>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <map>
 #include "buffer.hpp"
+#include "level.hpp"
 
-namespace log
+namespace logsys
 {
-    class AsyncLooper
+    const size_t CACHE_LINE_SIZE = 64;
+    const size_t RING_DEFAULT_CAPACITY = 4096;
+    const size_t BACKEND_POOL_DEFAULT_THREADS = 2;
+    const size_t DROP_OLDEST_FRACTION = 4; // DROP_OLDEST每次至少腾出容量的1/DROP_OLDEST_FRACTION
+
+    enum class LooperType
+    {
+        LOOPER_BUFFER = 0, // 互斥锁+条件变量的双缓冲区
+        LOOPER_RING        // 无锁多生产者环形队列
+    };
+
+    // 队列满时的处理策略
+    enum class OverflowPolicy
+    {
+        BLOCK = 0,        // 阻塞等待，可设置超时，超时后丢弃新日志
+        GROW,             // 扩容，不限制内存（环形队列无法扩容，按BLOCK处理）
+        DROP_NEWEST,      // 丢弃新日志
+        DROP_OLDEST,      // 丢弃最早的日志
+        DROP_BELOW_LEVEL  // 低于指定等级的新日志直接丢弃，其余阻塞等待
+    };
+    struct OverflowOption
+    {
+        OverflowPolicy _policy = OverflowPolicy::BLOCK;
+        Level _drop_level = Level::WARNING; // DROP_BELOW_LEVEL使用
+        size_t _timeout = 0;                // 阻塞等待的超时时间（毫秒），0表示一直等待
+    };
+
+    // 一次提交中包含的日志条数（按等级统计），单条日志可由等级隐式构造
+    struct LevelStat
+    {
+        std::array<uint32_t, LEVEL_COUNT> _cnt{};
+        Level _max = Level::UNKNOW;
+        LevelStat() {}
+        LevelStat(Level level) { add(level); }
+        void add(Level level)
+        {
+            ++_cnt[static_cast<size_t>(level)];
+            if (_max < level) _max = level;
+        }
+        void clear() { *this = LevelStat(); }
+    };
+    // 按等级统计被丢弃的日志条数
+    class DropCounter
+    {
+    public:
+        void add(const LevelStat &stat)
+        {
+            for (size_t i = 0; i < LEVEL_COUNT; ++i)
+                if (stat._cnt[i]) _cnt[i].fetch_add(stat._cnt[i], std::memory_order_relaxed);
+        }
+        size_t count(Level level) const { return _cnt[static_cast<size_t>(level)].load(std::memory_order_relaxed); }
+        size_t total() const
+        {
+            size_t ret = 0;
+            for (auto &cnt : _cnt) ret += cnt.load(std::memory_order_relaxed);
+            return ret;
+        }
+    private:
+        std::array<std::atomic<size_t>, LEVEL_COUNT> _cnt{};
+    };
+
+    // 异步事件循环基类，生产者只关心push，消费者通过回调批量处理数据
+    class Looper
+    {
+    public:
+        // level为本批日志的最高等级
+        using Func = std::function<void(const Fragment *frags, size_t n, Level level)>;
+        using ptr = std::shared_ptr<Looper>;
+    public:
+        virtual ~Looper() {}
+        // 返回false表示数据按溢出策略被丢弃
+        virtual bool push(const char *data, size_t len, const LevelStat &stat) = 0;
+        // 阻塞直到调用前push的数据全部交给回调处理完毕
+        virtual void flush() = 0;
+        const DropCounter &dropped() const { return _dropped; }
+    protected:
+        DropCounter _dropped;
+    };
+
+    // 可由后台线程池调度的任务，每次调用处理一批数据
+    class PoolTask
+    {
+    public:
+        virtual ~PoolTask() {}
+        virtual void runBatch() = 0;
+    };
+
+    // 后台线程池：多个异步日志器共享少量后台线程，而不是每个日志器独占一个线程
+    // 日志器有新数据时把自己放入就绪队列，空闲线程取出后处理一批；同一任务同一时刻只会被一个线程处理
+    class BackendPool
+    {
+    public:
+        using ptr = std::shared_ptr<BackendPool>;
+    public:
+        BackendPool(size_t threads = BACKEND_POOL_DEFAULT_THREADS) : _running(true)
+        {
+            for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+                _workers.emplace_back(&BackendPool::work, this);
+        }
+        // 使用该线程池的任务都持有它的引用，析构时队列中已不会再有任务
+        ~BackendPool()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _running = false;
+            }
+            _cond.notify_all();
+            for (auto &worker : _workers) worker.join();
+        }
+        void schedule(PoolTask *task)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _tasks.push_back(task);
+            }
+            _cond.notify_one();
+        }
+        size_t threads() const { return _workers.size(); }
+
+    private:
+        void work()
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            while (true)
+            {
+                _cond.wait(lock, [&](){return !_running || !_tasks.empty();});
+                if (_tasks.empty()) return;
+                PoolTask *task = _tasks.front();
+                _tasks.pop_front();
+                lock.unlock();
+                task->runBatch();
+                lock.lock();
+            }
+        }
+
+    private:
+        bool _running;
+        std::mutex _mtx;
+        std::condition_variable _cond;
+        std::deque<PoolTask *> _tasks; // 就绪队列，按先后顺序轮流处理各个日志器
+        std::vector<std::thread> _workers;
+    };
+
+    // 后台定时线程：日志器空闲时没有新数据驱动落地方向，按时间同步等定时工作由它触发
+    // 首次有任务时才创建线程；回调在定时线程中执行，返回下一次触发时间，time_point::max()表示不再触发
+    class BackendTimer
+    {
+    public:
+        using ptr = std::shared_ptr<BackendTimer>;
+        using TimePoint = std::chrono::steady_clock::time_point;
+        using Callback = TimePoint (*)(void *arg);
+    public:
+        // 使用者持有返回的引用，保证定时线程在所有使用者之后才销毁
+        static ptr getInstance()
+        {
+            static ptr timer(new BackendTimer());
+            return timer;
+        }
+        ~BackendTimer()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _running = false;
+            }
+            _cond.notify_all();
+            if (_thread.joinable()) _thread.join();
+        }
+        // 在when时刻以arg调用cb，同一arg已有任务时取较早的时间
+        void schedule(void *arg, Callback cb, TimePoint when)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                auto it = _tasks.find(arg);
+                if (it != _tasks.end())
+                {
+                    if (when >= it->second.first) return;
+                    it->second.first = when;
+                }
+                else _tasks.emplace(arg, std::make_pair(when, cb));
+                if (!_thread.joinable()) _thread = std::thread(&BackendTimer::loop, this);
+            }
+            _cond.notify_all();
+        }
+        // 取消arg的任务，返回时保证其回调不在执行中
+        void cancel(void *arg)
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _tasks.erase(arg);
+            if (_current != arg) return;
+            _cancelled = true;
+            _done_cond.wait(lock, [&](){return _current != arg;});
+        }
+
+    private:
+        BackendTimer() : _running(true), _current(nullptr), _cancelled(false) {}
+        void loop()
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            while (_running)
+            {
+                if (_tasks.empty())
+                {
+                    _cond.wait(lock);
+                    continue;
+                }
+                auto next = _tasks.begin();
+                for (auto it = _tasks.begin(); it != _tasks.end(); ++it)
+                    if (it->second.first < next->second.first) next = it;
+                if (std::chrono::steady_clock::now() < next->second.first)
+                {
+                    _cond.wait_until(lock, next->second.first);
+                    continue;
+                }
+                //执行期间任务不在表中，回调或其他线程重新注册的时间与返回的时间取较早者
+                void *arg = next->first;
+                Callback cb = next->second.second;
+                _tasks.erase(next);
+                _current = arg;
+                lock.unlock();
+                TimePoint when = cb(arg);
+                lock.lock();
+                _current = nullptr;
+                _done_cond.notify_all();
+                if (_cancelled || when == TimePoint::max())
+                {
+                    _cancelled = false;
+                    continue;
+                }
+                auto it = _tasks.find(arg);
+                if (it == _tasks.end()) _tasks.emplace(arg, std::make_pair(when, cb));
+                else if (when < it->second.first) it->second.first = when;
+            }
+        }
+
+    private:
+        bool _running;
+        std::mutex _mtx;
+        std::condition_variable _cond;
+        std::condition_variable _done_cond;
+        std::map<void *, std::pair<TimePoint, Callback>> _tasks; // 任务数量很少，直接遍历查找最早的
+        void *_current;                                          // 正在执行回调的任务
+        bool _cancelled;                                         // 正在执行的任务已被取消，回调返回后不再注册
+        std::thread _thread;
+    };
+
+    // 双缓冲区事件循环，默认独占一个线程；指定后台线程池时不再创建线程，有数据时交给线程池处理
+    class AsyncLooper : public Looper, public PoolTask
     {
     public:
-        using Func = std::function<void(Buffer &)>;
         using ptr = std::shared_ptr<AsyncLooper>;
     public:
+        // buffer_size为每块缓冲区的容量，实际内存按需分配
+        AsyncLooper(const Func &cb, const OverflowOption &option, const BackendPool::ptr &pool = nullptr,
+                    size_t buffer_size = BUFFER_DEFAULT_SIZE)
+            : _running(true),
+              _scheduled(false),
+              _push_cnt(0),
+              _done_cnt(0),
+              _push_level(Level::UNKNOW),
+              _push_task(buffer_size),
+              _pop_task(buffer_size),
+              _option(option),
+              _task_manage(cb),
+              _pool(pool)
+        {
+            //线程必须在其余成员均构造完成后再启动
+            if (!_pool) _looper = std::thread(&AsyncLooper::loop, this);
+        }
         AsyncLooper(const Func &cb, bool check_space = true)
-            : _task_manage(cb),
-              _running(true),
-              _looper(loop, this),
-              _check_space(check_space) {}
+            : AsyncLooper(cb, OverflowOption{check_space ? OverflowPolicy::BLOCK : OverflowPolicy::GROW}) {}
         ~AsyncLooper() { stop(); }
 
-    private:
-        void push(std::string &msg)
+        // 生产者接口：仅将数据拷贝进生产缓冲区，真正的落地由事件循环线程完成
+        bool push(const char *data, size_t len, const LevelStat &stat) override
         {
             //停止任务调度则结束任务添加操作
-            if(_running == false) return;
+            if(_running == false) return false;
             //否则在每个生命周期内添加一个任务
+            bool schedule = false;
             {
                 std::unique_lock<std::mutex> lock(_mtx);
-                _push_cond.wait(lock, [&](){return _push_task.writeAbleSize() >= msg.size();});
-                _push_task.push(msg.c_str(), msg.size());
+                //stop在锁内置位，锁内再检查一次，保证stop返回后不会再有数据写入或提交到线程池；
+                //ensureSpace等待空间时会释放锁，返回后需要重新检查
+                if(_running == false) return false;
+                if(!ensureSpace(lock, len, stat))
+                {
+                    _dropped.add(stat);
+                    return false;
+                }
+                if(_running == false) return false;
+                _push_task.push(data, len);
+                if(_push_level < stat._max) _push_level = stat._max;
+                if(_option._policy == OverflowPolicy::DROP_OLDEST) _records.push_back({len, stat});
+                ++_push_cnt;
+                //使用线程池时，尚未在就绪队列中（也没有在处理中）才需要提交
+                if(_pool && !_scheduled) schedule = _scheduled = true;
             }
             //此时任务调度线程就可以开始处理任务了
+            if(schedule) _pool->schedule(this);
+            else _pop_cond.notify_all();
+            return true;
+        }
+        // 线程池回调：处理一批数据，期间新到的数据由本任务重新排队处理，保证同一时刻只有一个线程调用回调
+        void runBatch() override
+        {
+            consume();
+            bool again;
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                again = !_push_task.empty();
+                _scheduled = again;
+                //在锁内通知，析构等待到_scheduled为false后本任务不会再访问任何成员
+                _flush_cond.notify_all();
+            }
+            if(again) _pool->schedule(this);
+        }
+        void flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            size_t target = _push_cnt;
             _pop_cond.notify_all();
+            _flush_cond.wait(lock, [&](){return _done_cnt >= target;});
+        }
+
+    private:
+        // 按溢出策略保证生产缓冲区有足够空间，返回false表示应丢弃当前数据（调用者需持有锁）
+        bool ensureSpace(std::unique_lock<std::mutex> &lock, size_t len, const LevelStat &stat)
+        {
+            //缓冲区为空时仍放不下说明单条数据超过了缓冲区大小，此时只能扩容，否则会永远等待
+            auto enough = [&](){return _push_task.writeAbleSize() >= len || _push_task.empty();};
+            if(enough()) return true;
+            switch(_option._policy)
+            {
+            case OverflowPolicy::GROW:
+                return true;
+            case OverflowPolicy::DROP_NEWEST:
+                return false;
+            case OverflowPolicy::DROP_OLDEST:
+            {
+                //从头部成批丢弃整条日志，一次至少腾出1/4的容量，再把剩余数据挪到缓冲区头部
+                //缓冲区保持满载时，挪动数据的开销由多次提交分摊，而不是每次提交都挪动整个缓冲区
+                size_t need = std::max(len, _push_task.capacity() / DROP_OLDEST_FRACTION);
+                while(_record_head < _records.size() && _push_task.readAbleSize() + need > _push_task.capacity())
+                {
+                    _push_task.pop(_records[_record_head].first);
+                    _dropped.add(_records[_record_head].second);
+                    ++_record_head;
+                }
+                _push_task.compact();
+                return true;
+            }
+            case OverflowPolicy::DROP_BELOW_LEVEL:
+                if(stat._max < _option._drop_level) return false;
+                [[fallthrough]];
+            default:
+                if(_option._timeout == 0)
+                {
+                    _push_cond.wait(lock, enough);
+                    return true;
+                }
+                return _push_cond.wait_for(lock, std::chrono::milliseconds(_option._timeout), enough);
+            }
         }
         // 事件循环，检测是否有任务可以处理，若有任务则交换缓冲区（上一次锁即可）
         void loop()
@@ -49,32 +396,284 @@ namespace log
                     //否则继续任务处理
                     //stop或者有任务待处理都可以直接继续运行代码，无需阻塞
                     _pop_cond.wait(lock, [&](){return !_push_task.empty() || !_running;});
-                    _pop_task.swap(_push_task);
                 }
-                _push_cond.notify_all();
-                // 唤醒生产者继续生产数据后，消费者就可以调用回调函数处理数据了，读写不冲突
-                _task_manage(_pop_task);
-                _pop_task.reset();
+                consume();
+                _flush_cond.notify_all();
+            }
+        }
+        // 交换缓冲区并处理其中的一批数据
+        void consume()
+        {
+            size_t batch_cnt;
+            Level batch_level;
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _pop_task.swap(_push_task);
+                _records.clear();
+                _record_head = 0;
+                batch_cnt = _push_cnt;
+                batch_level = _push_level;
+                _push_level = Level::UNKNOW;
             }
+            if(_pop_task.empty()) return;
+            _push_cond.notify_all();
+            // 唤醒生产者继续生产数据后，消费者就可以调用回调函数处理数据了，读写不冲突
+            Fragment frag{_pop_task.begin(), _pop_task.readAbleSize()};
+            _task_manage(&frag, 1, batch_level);
+            _pop_task.reset();
+            //通知等待刷新的线程
+            std::unique_lock<std::mutex> lock(_mtx);
+            _done_cnt = batch_cnt;
         }
-        // 停止任务调度
+        // 停止任务调度，已提交的数据全部处理完毕后返回
         void stop()
         {
-            _running = false;
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _running = false;
+                if(_pool)
+                {
+                    _flush_cond.wait(lock, [&](){return !_scheduled;});
+                    return;
+                }
+            }
             _pop_cond.notify_all();
             _looper.join();
         }
 
     private:
         std::atomic<bool> _running;         // 决定当前工作是否继续运行
+        bool _scheduled;                    // 是否在线程池的就绪队列中或正在被处理
         std::condition_variable _push_cond; // 是否满足任务添加条件
         std::condition_variable _pop_cond;  // 是否满足任务获取条件
+        std::condition_variable _flush_cond;// 是否已处理完flush前的数据
         std::mutex _mtx;                    // 条件变量相对应锁
+        size_t _push_cnt;                   // 已添加的任务数
+        size_t _done_cnt;                   // 已处理完毕的任务数
+        Level _push_level;                  // 生产缓冲区中日志的最高等级
         Buffer _push_task;                  // 任务添加缓冲区
         Buffer _pop_task;                   // 任务获取缓冲区
-        std::thread _looper;                // 事务循环处理器
-        bool _check_space;                  // 是否检查生产剩余空间是否够用，若不检查可能会触发扩容操作（这并非安全的）
+        // 生产缓冲区中每次提交的长度与等级，仅DROP_OLDEST使用；_record_head之前的已被丢弃
+        // 交换缓冲区时只清空不释放，稳定状态下记录不再分配内存
+        std::vector<std::pair<size_t, LevelStat>> _records;
+        size_t _record_head = 0;
+        OverflowOption _option;             // 缓冲区满时的处理策略，GROW会触发扩容（这并非安全的）
+        Func _task_manage;
+        BackendPool::ptr _pool;             // 共享的后台线程池，为空表示独占线程
+        std::thread _looper;                // 事务循环处理器，必须最后初始化，保证线程启动时其余成员均已构造完成
+    };
+
+    // 有界无锁环形队列（每个槽位带序号），生产者只需若干次原子操作，不再争抢同一把锁
+    // 消费者一次性取出所有可读槽位组成一个批次（槽位数据直接交换出来，不再拷贝），再调用一次回调落地
+    class RingLooper : public Looper
+    {
+    public:
+        using ptr = std::shared_ptr<RingLooper>;
+    public:
+        RingLooper(const Func &cb, size_t capacity = RING_DEFAULT_CAPACITY,
+                   const OverflowOption &option = OverflowOption())
+            : _running(true),
+              _sleeping(false),
+              _done_pos(0),
+              _option(option),
+              _mask(roundUp(capacity) - 1),
+              _slots(new Slot[_mask + 1]),
+              _enqueue_pos(0),
+              _dequeue_pos(0),
+              _task_manage(cb)
+        {
+            for (size_t i = 0; i <= _mask; ++i)
+                _slots[i]._seq.store(i, std::memory_order_relaxed);
+            _looper = std::thread(&RingLooper::loop, this);
+        }
+        ~RingLooper() { stop(); }
+
+        bool push(const char *data, size_t len, const LevelStat &stat) override
+        {
+            if (_running == false) return false;
+            size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+            std::chrono::steady_clock::time_point deadline;
+            bool waiting = false;
+            Slot *slot;
+            while (true)
+            {
+                slot = &_slots[pos & _mask];
+                size_t seq = slot->_seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                //槽位空闲，尝试占有
+                if (diff == 0)
+                {
+                    if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                //队列已满，按溢出策略处理
+                else if (diff < 0)
+                {
+                    if (_option._policy == OverflowPolicy::DROP_OLDEST) dropOldest();
+                    else if (_option._policy == OverflowPolicy::DROP_NEWEST ||
+                             (_option._policy == OverflowPolicy::DROP_BELOW_LEVEL && stat._max < _option._drop_level))
+                    {
+                        _dropped.add(stat);
+                        return false;
+                    }
+                    //其余策略让出CPU等待消费者取走数据
+                    else
+                    {
+                        if (_option._timeout)
+                        {
+                            auto now = std::chrono::steady_clock::now();
+                            if (!waiting) deadline = now + std::chrono::milliseconds(_option._timeout), waiting = true;
+                            else if (now >= deadline)
+                            {
+                                _dropped.add(stat);
+                                return false;
+                            }
+                        }
+                        if (_sleeping.load(std::memory_order_relaxed)) wakeUp();
+                        std::this_thread::yield();
+                    }
+                    pos = _enqueue_pos.load(std::memory_order_relaxed);
+                }
+                //被其他生产者抢先，重新读取位置
+                else pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+            //槽位中的string在回绕后会复用已有容量，稳定状态下不会再分配内存
+            slot->_data.assign(data, len);
+            slot->_stat = stat;
+            slot->_seq.store(pos + 1, std::memory_order_release);
+            //只有消费者真正睡眠时才需要唤醒，避免每次push都触发系统调用
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_sleeping.load(std::memory_order_relaxed)) wakeUp();
+            return true;
+        }
+        void flush() override
+        {
+            size_t target = _enqueue_pos.load();
+            wakeUp();
+            std::unique_lock<std::mutex> lock(_mtx);
+            _flush_cond.wait(lock, [&](){return _done_pos >= target;});
+        }
+
+    private:
+        struct alignas(CACHE_LINE_SIZE) Slot
+        {
+            std::atomic<size_t> _seq;
+            std::string _data;
+            LevelStat _stat;
+        };
+        static size_t roundUp(size_t n)
+        {
+            size_t ret = 2;
+            while (ret < n) ret <<= 1;
+            return ret;
+        }
+        bool readable()
+        {
+            size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+            return _slots[pos & _mask]._seq.load(std::memory_order_acquire) == pos + 1;
+        }
+        void wakeUp()
+        {
+            //加锁后再通知，防止消费者检测完条件尚未进入等待时丢失唤醒
+            { std::unique_lock<std::mutex> lock(_mtx); }
+            _cond.notify_one();
+        }
+        // 占有队首槽位，DROP_OLDEST策略下生产者也会出队，因此需要CAS
+        Slot *claim()
+        {
+            size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Slot *slot = &_slots[pos & _mask];
+                if (slot->_seq.load(std::memory_order_acquire) != pos + 1) return nullptr;
+                if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return slot;
+            }
+        }
+        void release(Slot *slot)
+        {
+            size_t pos = slot->_seq.load(std::memory_order_relaxed) - 1;
+            slot->_seq.store(pos + _mask + 1, std::memory_order_release);
+        }
+        void dropOldest()
+        {
+            Slot *slot = claim();
+            if (slot == nullptr) return;
+            _dropped.add(slot->_stat);
+            release(slot);
+        }
+        // 取出当前所有可读槽位，与批次中已清空的string交换，两边的容量都会被复用
+        size_t drain()
+        {
+            size_t cnt = 0;
+            _batch_level = Level::UNKNOW;
+            Slot *slot;
+            while (cnt <= _mask && (slot = claim()) != nullptr)
+            {
+                if (cnt == _batch.size()) _batch.emplace_back();
+                _batch[cnt].swap(slot->_data);
+                if (_batch_level < slot->_stat._max) _batch_level = slot->_stat._max;
+                release(slot);
+                ++cnt;
+            }
+            _frags.clear();
+            for (size_t i = 0; i < cnt; ++i)
+                _frags.push_back({_batch[i].data(), _batch[i].size()});
+            return cnt;
+        }
+        void loop()
+        {
+            while (true)
+            {
+                if (size_t cnt = drain())
+                {
+                    _task_manage(_frags.data(), cnt, _batch_level);
+                    for (size_t i = 0; i < cnt; ++i) _batch[i].clear();
+                    {
+                        std::unique_lock<std::mutex> lock(_mtx);
+                        _done_pos = _dequeue_pos.load(std::memory_order_relaxed);
+                    }
+                    _flush_cond.notify_all();
+                    continue;
+                }
+                //已停止时，需等到已占有槽位的生产者全部提交完毕才能退出事件循环
+                if (!_running)
+                {
+                    if (_enqueue_pos.load() == _dequeue_pos.load(std::memory_order_relaxed)) return;
+                    std::this_thread::yield();
+                    continue;
+                }
+                //进入睡眠前再检查一次，与生产者的内存屏障配合避免丢失唤醒，超时等待作为兜底
+                std::unique_lock<std::mutex> lock(_mtx);
+                _sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!readable() && _running)
+                    _cond.wait_for(lock, std::chrono::milliseconds(1));
+                _sleeping.store(false, std::memory_order_relaxed);
+            }
+        }
+        void stop()
+        {
+            _running = false;
+            wakeUp();
+            _looper.join();
+        }
+
     private:
+        std::atomic<bool> _running;
+        std::atomic<bool> _sleeping;         // 消费者是否处于睡眠状态
+        std::mutex _mtx;                     // 仅用于消费者睡眠与唤醒以及flush等待
+        std::condition_variable _cond;
+        std::condition_variable _flush_cond;
+        size_t _done_pos;                    // 已交给回调处理完毕的位置
+        OverflowOption _option;              // 队列满时的处理策略
+        size_t _mask;                        // 容量-1，容量为2的幂
+        std::unique_ptr<Slot[]> _slots;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> _enqueue_pos; // 生产者位置，独占缓存行避免伪共享
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> _dequeue_pos; // 消费者位置
+        alignas(CACHE_LINE_SIZE) std::vector<std::string> _batch; // 消费者批处理数据，从槽位交换而来
+        std::vector<Fragment> _frags;
+        Level _batch_level;                  // 本批日志的最高等级
         Func _task_manage;
+        std::thread _looper;
     };
 };
\ No newline at end of file
@@ -4,19 +4,105 @@
 #include "util.hpp"
 #include <memory>
 #include <thread>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <format>
+#include <type_traits>
 
-namespace log
+namespace logsys
 {
+    // 日志语句的静态信息，由日志宏以static constexpr形式生成，整个程序生命周期内有效
+    struct CallSite {
+        const char *_file;//文件名
+        const char *_func;//函数名
+        size_t _line;//行号
+        Level _level;//等级
+        std::string_view _fmt;//格式串
+    };
+    // 结构化字段，由结构化格式化器输出；_quoted为false表示值是数字或布尔，按原样输出
+    struct LogField {
+        std::string _key;
+        std::string _value;
+        bool _quoted;
+    };
+    // 日志调用中以logsys::kv(key, value)传入的键值对，既作为结构化字段输出，也可以像普通参数一样被格式串引用
+    template <class T>
+    struct KeyValue {
+        std::string_view _key;
+        const T &_value;
+    };
+    template <class T>
+    KeyValue<T> kv(std::string_view key, const T &value) { return {key, value}; }
+
+    // 键值对按值的类型格式化，字符数组按C字符串处理
+    template <class T>
+    using KeyValueType = std::conditional_t<std::is_array_v<T>, const std::remove_extent_t<T> *, T>;
+
+    template <class T>
+    struct IsKeyValue : std::false_type {};
+    template <class T>
+    struct IsKeyValue<KeyValue<T>> : std::true_type {};
+    template <class T>
+    concept KeyValueArg = IsKeyValue<std::decay_t<T>>::value;
+
+    template <class T>
+    LogField makeField(const KeyValue<T> &kv)
+    {
+        using V = std::decay_t<T>;
+        if constexpr (std::is_same_v<V, bool>)
+            return {std::string(kv._key), kv._value ? "true" : "false", false};
+        else if constexpr (std::is_arithmetic_v<V> && !std::is_same_v<V, char>)
+        {
+            //非有限的浮点数不是合法的JSON数字，按字符串输出；NaN不等于自身，无穷减去自身为NaN
+            bool finite = true;
+            if constexpr (std::is_floating_point_v<V>) finite = kv._value == kv._value && kv._value - kv._value == 0;
+            return {std::string(kv._key), std::format("{}", kv._value), !finite};
+        }
+        else return {std::string(kv._key), std::format("{}", kv._value), true};
+    }
+    // 从日志调用的参数中收集键值对
+    template <class... Args>
+    void collectFields(std::vector<LogField> &fields, const Args &...args)
+    {
+        auto collect = [&](const auto &arg) {
+            if constexpr (KeyValueArg<decltype(arg)>) fields.push_back(makeField(arg));
+        };
+        (collect(args), ...);
+    }
+
+    // 名称、文件名与消息只是视图，不拷贝内容：日志器名称与调用点信息在日志器生命周期内有效，
+    // 消息位于线程本地的缓冲区中，调用者需保证它们在格式化完成前有效
     struct LogMsg {
         size_t _line;//行号
-        time_t _time;//时间
+        time_t _time;//时间（秒）
+        uint32_t _nsec;//时间的纳秒部分
         std::thread::id _tid;//线程ID
-        std::string _name;//名称
-        std::string _file;//文件名
-        std::string _payload;//消息
+        std::string_view _name;//名称
+        std::string_view _file;//文件名
+        std::string_view _payload;//消息
         Level _level;//等级
-        LogMsg(const std::string &name, const std::string file, size_t line, const std::string &&payload, 
-            Level level): _name(name), _file(file), _payload(std::move(payload)), _level(level),
-            _line(line), _time(Date::now()), _tid(std::this_thread::get_id()) {}
+        std::vector<LogField> _fields;//结构化字段，没有字段时不分配内存
+        LogMsg(std::string_view name, std::string_view file, size_t line, std::string_view payload,
+            Level level): _line(line), _tid(std::this_thread::get_id()), _name(name), _file(file),
+            _payload(payload), _level(level)
+        {
+            int64_t ns = Date::nowNs();
+            _time = ns / NSEC_PER_SEC;
+            _nsec = ns % NSEC_PER_SEC;
+        }
+        //延迟格式化时，时间与线程ID在生产者线程中记录
+        LogMsg(std::string_view name, std::string_view file, size_t line, std::string_view payload,
+            Level level, time_t time, uint32_t nsec, std::thread::id tid): _line(line), _time(time), _nsec(nsec),
+            _tid(tid), _name(name), _file(file), _payload(payload), _level(level) {}
     };
-};
\ No newline at end of file
+};
+
+template <class T>
+struct std::formatter<logsys::KeyValue<T>> : std::formatter<logsys::KeyValueType<T>>
+{
+    auto format(const logsys::KeyValue<T> &kv, std::format_context &ctx) const
+    {
+        return std::formatter<logsys::KeyValueType<T>>::format(kv._value, ctx);
+    }
+};
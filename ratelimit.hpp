@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// 调用点级别的限流与采样：限流器以static变量的形式放在日志宏展开的语句块中，每个调用点独立计数，
+// 检查只涉及该调用点自己的原子变量，无锁，代价远低于格式化一条日志
+// 被拦下的条数累计在限流器中，由下一条放行的日志带出（文本末尾追加说明，并附加suppressed字段）
+// 用法：LOG_RATE_LIMITED(logger, logsys::Level::ERROR, 10, 20, "read failed: {}", err);
+namespace logsys
+{
+    // 限流器公共部分，Policy需提供bool allow()
+    template <class Policy>
+    class RateLimit
+    {
+    public:
+        // 放行时返回true，suppressed为上次放行以来被拦下的条数
+        bool acquire(size_t &suppressed)
+        {
+            if (!static_cast<Policy *>(this)->allow())
+            {
+                _suppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            //大多数情况下没有被拦下的日志，先读一次避免无谓的写操作
+            suppressed = _suppressed.load(std::memory_order_relaxed) ? _suppressed.exchange(0, std::memory_order_relaxed) : 0;
+            return true;
+        }
+
+    private:
+        std::atomic<size_t> _suppressed{0};
+    };
+
+    // 令牌桶：平均每秒放行per_second条，允许最多burst条的突发
+    // 以GCRA实现，只需一个原子变量记录理论到达时间，无需单独的补充令牌操作
+    // 间隔与突发容量都不超过NEVER，保证理论到达时间的加法不会溢出；per_second<=0时只放行第一条
+    class TokenBucket : public RateLimit<TokenBucket>
+    {
+    public:
+        TokenBucket(double per_second, size_t burst = 1)
+            : _interval(per_second > 0 && NSEC / per_second < NEVER ? static_cast<int64_t>(NSEC / per_second) : NEVER),
+              _tolerance(tolerance(_interval, burst ? burst : 1)) {}
+        bool allow()
+        {
+            int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            int64_t tat = _tat.load(std::memory_order_relaxed);
+            while (true)
+            {
+                int64_t next = (tat > now ? tat : now) + _interval;
+                if (next - now > _tolerance) return false;
+                if (_tat.compare_exchange_weak(tat, next, std::memory_order_relaxed)) return true;
+            }
+        }
+
+    private:
+        static int64_t tolerance(int64_t interval, size_t burst)
+        {
+            if (interval == 0) return 0;
+            return burst > static_cast<size_t>(NEVER / interval) ? NEVER : interval * static_cast<int64_t>(burst);
+        }
+
+    private:
+        static constexpr double NSEC = 1e9;
+        static constexpr int64_t NEVER = INT64_MAX / 4; // 约73年，视为不再补充令牌
+        int64_t _interval;              // 每个令牌对应的纳秒数
+        int64_t _tolerance;             // 突发容量对应的纳秒数
+        std::atomic<int64_t> _tat{0};   // 理论到达时间
+    };
+
+    // 前first条全部放行，之后每every条放行一条，every为0表示之后全部拦下
+    class EveryN : public RateLimit<EveryN>
+    {
+    public:
+        EveryN(size_t first, size_t every) : _first(first), _every(every) {}
+        bool allow()
+        {
+            size_t n = _count.fetch_add(1, std::memory_order_relaxed);
+            if (n < _first) return true;
+            return _every && (n - _first + 1) % _every == 0;
+        }
+
+    private:
+        size_t _first;
+        size_t _every;
+        std::atomic<size_t> _count{0};
+    };
+
+    // 按概率采样，随机数由线程本地的xorshift生成器产生，调用点之间不共享状态
+    class Sampler : public RateLimit<Sampler>
+    {
+    public:
+        Sampler(double probability)
+            : _threshold(probability >= 1 ? UINT64_MAX
+                         : probability <= 0 ? 0
+                                            : static_cast<uint64_t>(probability * 18446744073709551616.0)) {}
+        bool allow()
+        {
+            return _threshold == UINT64_MAX || next() < _threshold;
+        }
+
+    private:
+        static uint64_t next()
+        {
+            thread_local uint64_t state = seed();
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+        static uint64_t seed()
+        {
+            uint64_t s = std::chrono::steady_clock::now().time_since_epoch().count();
+            s ^= reinterpret_cast<uintptr_t>(&s);
+            return s ? s : 0x9e3779b97f4a7c15ull;
+        }
+
+    private:
+        uint64_t _threshold;
+    };
+};
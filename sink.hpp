@@ -1,12 +1,45 @@
 #pragma once
 
 #include "util.hpp"
+#include "level.hpp"
+#include "buffer.hpp"
+#include "uring.hpp"
+#include "looper.hpp"
+#include "archive.hpp"
 #include <memory>
-#include <fstream>
-#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
 
-namespace log
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+namespace logsys
 {
+    const size_t MMAP_SEGMENT_SIZE = 32 * 1024 * 1024;
+    const size_t URING_DEFAULT_DEPTH = 4;
+    const size_t ASYNC_SINK_CAPACITY = 64 * 1024 * 1024;
+
+    // 持久化策略，各项可以组合；默认不做任何同步，数据交给内核后即返回
+    struct SyncOption
+    {
+        bool _flush = false;       // 每批数据写完后刷新用户态缓冲（标准输出、在途的异步写请求）
+        size_t _bytes = 0;         // 累计写入该字节数后同步到磁盘，0表示不启用
+        size_t _interval = 0;      // 距上次同步超过该时间（毫秒）后同步到磁盘，0表示不启用
+        Level _level = Level::OFF; // 一批日志中出现不低于该等级的日志时同步到磁盘，OFF表示不启用
+    };
+
     // 简单工厂模式，基类
     class LogSink
     {
@@ -14,9 +47,185 @@ namespace log
         using ptr = std::shared_ptr<LogSink>;
 
     public:
-        LogSink() {};
+        LogSink() : _unsynced(0), _last_sync(std::chrono::steady_clock::now()) {};
         virtual ~LogSink() {};
         virtual void log(const char *data, size_t len) = 0;
+        // 批量落地接口，异步线程把一整批数据一次性交给落地方向，默认逐段调用log
+        virtual void logBatch(const Fragment *frags, size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+                log(frags[i]._data, frags[i]._len);
+        }
+        // 能否直接接收延迟格式化记录而非渲染后的文本（如二进制落地），日志器含有这类落地方向时会启用延迟格式化
+        virtual bool acceptRecords() const { return false; }
+        // 接收一批延迟格式化记录（见DeferredCodec），name为日志器名称
+        virtual void logRecords(const Fragment *frags, size_t n, const std::string &name) {}
+        // 将用户态缓冲的数据交给内核
+        virtual void flush() {}
+        // 将数据同步到磁盘
+        virtual void sync() { flush(); }
+
+        void setSync(const SyncOption &option) { _sync = option; }
+        // 文件操作（打开、写入、同步）失败的次数与因此丢失的字节数，不写文件的落地方向始终为0
+        virtual size_t errors() const { return 0; }
+        virtual size_t lostBytes() const { return 0; }
+        // 一批数据写完后由日志器调用，level为该批日志的最高等级
+        // 按持久化策略决定是否同步，一次同步覆盖此前写入的所有数据（组提交）
+        // 按时间同步除了在每批数据写完时检查，日志器空闲时还由后台定时器按syncDeadline调用syncIfDue
+        void commit(size_t len, Level level)
+        {
+            _unsynced += len;
+            if (_unsynced == 0) return;
+            bool need_sync = level >= _sync._level || (_sync._bytes && _unsynced >= _sync._bytes);
+            if (!need_sync && _sync._interval)
+                need_sync = std::chrono::steady_clock::now() >= syncDeadline();
+            if (need_sync) syncNow();
+            else if (_sync._flush) flush();
+        }
+        // 尚未同步的数据按时间策略最晚应同步的时刻，没有待同步数据或未启用按时间同步时为time_point::max()
+        std::chrono::steady_clock::time_point syncDeadline() const
+        {
+            if (_sync._interval == 0 || _unsynced == 0) return std::chrono::steady_clock::time_point::max();
+            return _last_sync + std::chrono::milliseconds(_sync._interval);
+        }
+        // 到达syncDeadline时同步，调用者需保证与写入该落地方向的线程互斥
+        void syncIfDue()
+        {
+            if (std::chrono::steady_clock::now() >= syncDeadline()) syncNow();
+        }
+
+    protected:
+        // 是否启用了同步到磁盘的策略，文件落地在切换或关闭文件前据此同步剩余数据
+        bool syncEnabled() const { return _sync._bytes || _sync._interval || _sync._level != Level::OFF; }
+
+    private:
+        void syncNow()
+        {
+            sync();
+            _unsynced = 0;
+            _last_sync = std::chrono::steady_clock::now();
+        }
+
+    private:
+        SyncOption _sync;
+        size_t _unsynced;  // 上次同步后写入的字节数
+        std::chrono::steady_clock::time_point _last_sync;
+    };
+
+    // 文件操作的错误统计：同一操作的同一错误只在首次出现时输出到标准错误，之后只计数，避免磁盘写满时刷屏
+    // 计数可以在其他线程读取
+    class IoError
+    {
+    public:
+        // op为失败的操作，lost为因此丢失的字节数，detail附加在文件名之后
+        void report(const std::string &filename, const char *op, int err, size_t lost = 0,
+                    const std::string &detail = "")
+        {
+            _errors.fetch_add(1, std::memory_order_relaxed);
+            _lost_bytes.fetch_add(lost, std::memory_order_relaxed);
+            if (err == _last_error && op == _last_op) return;
+            _last_error = err;
+            _last_op = op;
+            std::cerr << op << "日志文件" << filename << detail << "失败：" << std::strerror(err) << std::endl;
+        }
+        size_t errors() const { return _errors.load(std::memory_order_relaxed); }
+        size_t lostBytes() const { return _lost_bytes.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<size_t> _errors{0};
+        std::atomic<size_t> _lost_bytes{0};
+        int _last_error = 0; // 最近一次报告的错误码与操作
+        const char *_last_op = nullptr;
+    };
+
+    // 追加写入的文件，直接使用文件描述符，不经过filebuf的额外缓冲
+    // 批量写入使用writev，一次系统调用即可写完一整批数据
+    // 打开、写入与同步失败时计数并报告，不会中断日志器；文件未能打开时写入的数据计为丢失
+    class LogFile
+    {
+    public:
+        LogFile() : _fd(-1) {}
+        LogFile(const LogFile &) = delete;
+        LogFile &operator=(const LogFile &) = delete;
+        ~LogFile() { close(); }
+        bool isOpen() const { return _fd >= 0; }
+        bool open(const std::string &filename)
+        {
+            close();
+            _filename = filename;
+            _fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (_fd < 0) _error.report(_filename, "打开", errno);
+            return _fd >= 0;
+        }
+        bool sync()
+        {
+            if (_fd < 0) return false;
+            if (::fdatasync(_fd) == 0) return true;
+            _error.report(_filename, "同步", errno);
+            return false;
+        }
+        void close()
+        {
+            if (_fd < 0) return;
+            ::close(_fd);
+            _fd = -1;
+        }
+        bool write(const char *data, size_t len)
+        {
+            Fragment frag{data, len};
+            return write(&frag, 1);
+        }
+        // 处理短写与EINTR，片段数超过IOV_MAX时分多次写入；失败时未写入的部分计为丢失
+        bool write(const Fragment *frags, size_t n)
+        {
+            if (_fd < 0) return lose(frags, n, 0, 0, EBADF);
+            struct iovec iov[IOV_MAX];
+            size_t idx = 0, offset = 0; // 下一个待写入的片段及其已写入的长度
+            while (idx < n)
+            {
+                int cnt = 0;
+                for (size_t i = idx; i < n && cnt < IOV_MAX; ++i)
+                {
+                    size_t skip = i == idx ? offset : 0;
+                    if (frags[i]._len == skip) continue;
+                    iov[cnt].iov_base = const_cast<char *>(frags[i]._data + skip);
+                    iov[cnt++].iov_len = frags[i]._len - skip;
+                }
+                if (cnt == 0) return true;
+                ssize_t ret = ::writev(_fd, iov, cnt);
+                if (ret < 0)
+                {
+                    if (errno == EINTR) continue;
+                    return lose(frags, n, idx, offset, errno);
+                }
+                size_t written = ret;
+                while (idx < n && written >= frags[idx]._len - offset)
+                {
+                    written -= frags[idx]._len - offset;
+                    offset = 0;
+                    ++idx;
+                }
+                offset += written;
+            }
+            return true;
+        }
+        size_t errors() const { return _error.errors(); }
+        size_t lostBytes() const { return _error.lostBytes(); }
+
+    private:
+        // 从第idx个片段的offset处开始的数据未能写入
+        bool lose(const Fragment *frags, size_t n, size_t idx, size_t offset, int err)
+        {
+            size_t lost = 0;
+            for (size_t i = idx; i < n; ++i) lost += frags[i]._len;
+            _error.report(_filename, "写入", err, lost - offset);
+            return false;
+        }
+
+    private:
+        int _fd;
+        std::string _filename;
+        IoError _error;
     };
 
     // 标准输出落地
@@ -28,6 +237,19 @@ namespace log
         {
             std::cout.write(data, len);
         }
+        void flush() override
+        {
+            std::cout.flush();
+        }
+    };
+
+    // 空落地，丢弃所有数据，用于衡量日志器本身的开销
+    class NullLogSink : public LogSink
+    {
+    public:
+        NullLogSink() {};
+        void log(const char *data, size_t len) override {}
+        void logBatch(const Fragment *frags, size_t n) override {}
     };
 
     // 指定文件落地
@@ -38,22 +260,275 @@ namespace log
             : _filename(filename)
         {
             File::createDirectory(File::getPath(filename));
-            _ofs.open(_filename, std::ios::app | std::ios::binary);
-            assert(_ofs.is_open());
+            _file.open(_filename);
         }
         void log(const char *data, size_t len) override
         {
-            _ofs.write(data, len);
-            assert(_ofs.good());
+            _file.write(data, len);
         }
+        void logBatch(const Fragment *frags, size_t n) override
+        {
+            _file.write(frags, n);
+        }
+        void sync() override
+        {
+            _file.sync();
+        }
+        size_t errors() const override { return _file.errors(); }
+        size_t lostBytes() const override { return _file.lostBytes(); }
         ~FixedFileLogSink()
         {
-            _ofs.close();
+            if (syncEnabled()) _file.sync();
         }
 
     private:
         std::string _filename;
-        std::ofstream _ofs;
+        LogFile _file;
+    };
+
+    // 内存映射文件落地：按段预分配文件空间并映射，写日志只是一次memcpy，稳定状态下没有系统调用
+    // 数据写入映射后即位于页缓存中，进程崩溃也不会丢失；关闭时截掉未使用的预分配部分
+    // 崩溃后文件尾部会残留未使用的'\0'，重新打开时会跳过它们继续追加
+    class MmapFileLogSink : public LogSink
+    {
+    public:
+        MmapFileLogSink(const std::string &filename, size_t segment_size = MMAP_SEGMENT_SIZE)
+            : _filename(filename),
+              _segment_size(segment_size),
+              _fd(-1),
+              _map(nullptr),
+              _map_offset(0),
+              _map_pos(0),
+              _offset(0)
+        {
+            if (segment_size == 0) throw std::runtime_error("映射段大小不能为0");
+            //映射的起始偏移必须按页对齐，段大小也按页取整
+            size_t page = sysconf(_SC_PAGESIZE);
+            _segment_size = (segment_size + page - 1) / page * page;
+            _map_pos = _segment_size;
+            File::createDirectory(File::getPath(filename));
+            _fd = ::open(_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (_fd < 0) _error.report(_filename, "打开", errno);
+            else _offset = dataEnd();
+        }
+        ~MmapFileLogSink()
+        {
+            unmap();
+            if (_fd < 0) return;
+            int ret = ftruncate(_fd, _offset);
+            (void)ret;
+            if (syncEnabled()) sync();
+            ::close(_fd);
+        }
+        void log(const char *data, size_t len) override
+        {
+            while (len)
+            {
+                if (_map_pos == _segment_size && !remap())
+                {
+                    _error.report(_filename, "映射", errno, len);
+                    return;
+                }
+                size_t n = std::min(len, _segment_size - _map_pos);
+                std::memcpy(_map + _map_pos, data, n);
+                _map_pos += n;
+                _offset += n;
+                data += n;
+                len -= n;
+            }
+        }
+        void logBatch(const Fragment *frags, size_t n) override
+        {
+            for (size_t i = 0; i < n; ++i)
+                log(frags[i]._data, frags[i]._len);
+        }
+        // 映射中的数据已位于页缓存，fdatasync会一并写回通过映射修改的页
+        void sync() override
+        {
+            if (_fd >= 0 && ::fdatasync(_fd) < 0) _error.report(_filename, "同步", errno);
+        }
+        size_t errors() const override { return _error.errors(); }
+        size_t lostBytes() const override { return _error.lostBytes(); }
+
+    private:
+        // 文件中有效数据的末尾：跳过上次崩溃残留的预分配空间
+        off_t dataEnd()
+        {
+            struct stat st;
+            if (fstat(_fd, &st) < 0) return 0;
+            off_t end = st.st_size;
+            char buf[4096];
+            while (end > 0)
+            {
+                size_t len = std::min<off_t>(end, sizeof(buf));
+                if (pread(_fd, buf, len, end - len) != (ssize_t)len) break;
+                size_t i = len;
+                while (i > 0 && buf[i - 1] == '\0') --i;
+                end -= len - i;
+                if (i) break;
+            }
+            return end;
+        }
+        void unmap()
+        {
+            if (_map == nullptr) return;
+            munmap(_map, _segment_size);
+            _map = nullptr;
+        }
+        // 映射从当前写入位置开始的下一段，段内写满后再次调用；失败时errno为失败原因
+        bool remap()
+        {
+            unmap();
+            if (_fd < 0)
+            {
+                errno = EBADF;
+                return false;
+            }
+            _map_offset = _offset / _segment_size * _segment_size;
+            _map_pos = _offset - _map_offset;
+            off_t end = _map_offset + _segment_size;
+            //预分配磁盘空间，文件系统不支持时退化为稀疏文件
+            if (::fallocate(_fd, 0, _map_offset, _segment_size) < 0)
+            {
+                struct stat st;
+                if (fstat(_fd, &st) < 0 || (st.st_size < end && ftruncate(_fd, end) < 0))
+                {
+                    _map_pos = _segment_size;
+                    return false;
+                }
+            }
+            void *map = mmap(nullptr, _segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, _map_offset);
+            if (map == MAP_FAILED)
+            {
+                _map_pos = _segment_size;
+                return false;
+            }
+            _map = static_cast<char *>(map);
+            return true;
+        }
+
+    private:
+        std::string _filename;
+        size_t _segment_size;
+        int _fd;
+        char *_map;         // 当前映射段
+        off_t _map_offset;  // 当前映射段在文件中的偏移
+        size_t _map_pos;    // 段内写入位置，初始等于段大小表示尚未映射
+        off_t _offset;      // 文件中有效数据的长度
+        IoError _error;
+    };
+
+    // 异步写入的文件落地：每批数据拷贝到一个空闲缓冲区后提交写请求即返回，最多depth批同时在写，
+    // 磁盘延迟抖动只会占用在途缓冲区，不会直接阻塞异步线程；缓冲区全部在途时才等待最早完成的请求
+    // 优先使用io_uring，不可用时退化为pwrite线程池
+    class UringFileLogSink : public LogSink
+    {
+    public:
+        UringFileLogSink(const std::string &filename, size_t depth = URING_DEFAULT_DEPTH)
+            : _filename(filename),
+              _pending(depth)
+        {
+            if (depth == 0) throw std::runtime_error("在途请求数不能为0");
+            File::createDirectory(File::getPath(filename));
+            //写入位置由自己维护，不能使用O_APPEND（Linux下会忽略pwrite的偏移）
+            _fd = ::open(_filename.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+            if (_fd < 0) _error.report(_filename, "打开", errno);
+            _offset = _fd < 0 ? 0 : lseek(_fd, 0, SEEK_END);
+            _writer = createAsyncWriter(_fd, depth);
+            for (auto &pending : _pending) _free.push_back(&pending);
+        }
+        ~UringFileLogSink()
+        {
+            if (syncEnabled()) sync();
+            else flush();
+            _writer.reset();
+            if (_fd >= 0) ::close(_fd);
+        }
+        void log(const char *data, size_t len) override
+        {
+            Fragment frag{data, len};
+            logBatch(&frag, 1);
+        }
+        void logBatch(const Fragment *frags, size_t n) override
+        {
+            Pending *pending = acquire();
+            pending->_data.clear();
+            for (size_t i = 0; i < n; ++i)
+                pending->_data.append(frags[i]._data, frags[i]._len);
+            if (pending->_data.empty())
+            {
+                _free.push_back(pending);
+                return;
+            }
+            pending->_req._data = pending->_data.data();
+            pending->_req._len = pending->_data.size();
+            pending->_req._offset = _offset;
+            _offset += pending->_data.size();
+            _writer->submit(&pending->_req);
+        }
+        // 等待所有在途请求完成
+        void flush() override
+        {
+            while (_free.size() != _pending.size()) complete(_writer->wait());
+        }
+        void sync() override
+        {
+            flush();
+            if (_fd >= 0 && ::fdatasync(_fd) < 0) _error.report(_filename, "同步", errno);
+        }
+        // 写入失败的区间在文件中留下空洞（读出为0）
+        size_t errors() const override { return _error.errors(); }
+        size_t lostBytes() const override { return _error.lostBytes(); }
+
+    private:
+        // 在途缓冲区，_req必须是第一个成员，完成时由请求地址得到缓冲区
+        struct Pending
+        {
+            WriteRequest _req;
+            std::string _data;
+        };
+        Pending *acquire()
+        {
+            while (_free.empty()) complete(_writer->wait());
+            Pending *pending = _free.back();
+            _free.pop_back();
+            return pending;
+        }
+        // 处理一个完成的请求，短写时继续提交剩余部分，出错时计数并报告后丢弃该批数据
+        void complete(WriteRequest *req)
+        {
+            if (req->_res == -EINTR || req->_res == -EAGAIN)
+            {
+                _writer->submit(req);
+                return;
+            }
+            if (req->_res > 0 && (size_t)req->_res < req->_len)
+            {
+                req->_data += req->_res;
+                req->_len -= req->_res;
+                req->_offset += req->_res;
+                _writer->submit(req);
+                return;
+            }
+            //写入0字节说明无法继续推进，与出错同样处理，避免无限重试
+            if (req->_res <= 0) fail(req);
+            _free.push_back(reinterpret_cast<Pending *>(req));
+        }
+        void fail(const WriteRequest *req)
+        {
+            int err = req->_res < 0 ? -req->_res : EIO;
+            _error.report(_filename, "写入", err, req->_len,
+                          "（偏移" + std::to_string(req->_offset) + "，" + std::to_string(req->_len) + "字节）");
+        }
+
+    private:
+        std::string _filename;
+        int _fd;
+        off_t _offset;                  // 下一批数据的写入位置
+        IoError _error;
+        std::vector<Pending> _pending;
+        std::vector<Pending *> _free;
+        AsyncWriter::ptr _writer;       // 需在_pending之前析构
     };
 
     // 滚动文件落地
@@ -63,6 +538,7 @@ namespace log
         RollBySizeLogSink(const std::string &filename, size_t max_size, bool prev_check = false, bool cst_inc = false)
             : _filename(filename),
               _max_size(max_size),
+              _cur_size(0),
               _cur_suffix(1),
               _last_time(0),
               _prev_check(prev_check),
@@ -74,9 +550,44 @@ namespace log
         void log(const char *data, size_t len) override
         {
             checkStat(len);
-            _ofs.write(data, len);
+            _file.write(data, len);
             _cur_size += len;
-            assert(_ofs.good());
+        }
+        // 不需要切换文件的连续片段合并为一次写入
+        void logBatch(const Fragment *frags, size_t n) override
+        {
+            size_t idx = 0;
+            while (idx < n)
+            {
+                if (frags[idx]._len > _max_size)
+                {
+                    logLines(frags[idx++]);
+                    continue;
+                }
+                checkStat(frags[idx]._len);
+                size_t end = idx + 1, size = _cur_size + frags[idx]._len;
+                while (end < n && frags[end]._len <= _max_size && !isFull(size, frags[end]._len))
+                    size += frags[end++]._len;
+                _file.write(frags + idx, end - idx);
+                _cur_size = size;
+                idx = end;
+            }
+        }
+        // 一个片段可能包含整批日志，超过文件大小上限时按行切分后逐段写入
+        void logLines(const Fragment &frag)
+        {
+            const char *data = frag._data, *end = frag._data + frag._len;
+            while (data < end)
+            {
+                size_t len = std::min<size_t>(end - data, _max_size);
+                if (data + len < end)
+                {
+                    const char *pos = static_cast<const char *>(memrchr(data, '\n', len));
+                    if (pos) len = pos - data + 1;
+                }
+                log(data, len);
+                data += len;
+            }
         }
         void checkStat(size_t len)
         {
@@ -84,18 +595,38 @@ namespace log
             if (len > _max_size)
                 throw std::runtime_error("The log is too long!");
             // 若继续写文件会导致长度溢出，则需要重新开一个文件
-            if (!_ofs.is_open() || !_prev_check && _cur_size + len > _max_size || _prev_check && _cur_size >= _max_size)
+            if (!_file.isOpen() || isFull(_cur_size, len))
             {
-                _ofs.close();
-                std::string new_file_name = newFileName();
-                _ofs.open(new_file_name, std::ios::app | std::ios::binary);
-                assert(_ofs.is_open());
+                if (syncEnabled()) _file.sync();
+                std::string old_file = _cur_file;
+                _cur_file = newFileName();
+                _file.open(_cur_file);
                 _cur_size = 0;
+                if (_archiver && !old_file.empty()) _archiver->push(old_file, _cur_file);
             }
         }
+        // 启用归档：切换下来的文件在后台压缩，并按数量、大小、时间清理旧文件
+        void setArchive(const ArchiveOption &option)
+        {
+            _archiver = std::make_shared<Archiver>(_filename, option);
+        }
+        bool isFull(size_t cur_size, size_t len)
+        {
+            return !_prev_check && cur_size + len > _max_size || _prev_check && cur_size >= _max_size;
+        }
+        void sync() override
+        {
+            _file.sync();
+        }
+        size_t errors() const override { return _file.errors(); }
+        size_t lostBytes() const override { return _file.lostBytes(); }
+        ~RollBySizeLogSink()
+        {
+            if (syncEnabled()) _file.sync();
+        }
         std::string newFileName()
         {
-            time_t t = log::Date::now();
+            time_t t = logsys::Date::now();
             struct tm _tm;
             #ifdef _WIN32
             localtime_s(&_tm, &t);
@@ -113,14 +644,11 @@ namespace log
             ret += "-" + std::to_string(_cur_suffix++);
             return ret;
         }
-        ~RollBySizeLogSink()
-        {
-            _ofs.close();
-        }
 
     private:
         std::string _filename;
-        std::ofstream _ofs;
+        std::string _cur_file; // 当前正在写入的文件
+        LogFile _file;
         size_t _max_size;
         size_t _cur_size;
         size_t _cur_suffix;
@@ -129,6 +657,359 @@ namespace log
         // 超出，若不提前检查，可能会在文件大小超出范围后被检查出来
         bool _cst_inc; //是否让文件后缀不断增加，若不断增加，即便文件名不同，也会继承上次的文件后缀加一作为该文件的后缀，
         //否则每次文件名不同的时候会使用新的后缀（后缀从1开始重新计算）
+        Archiver::ptr _archiver; // 需最先析构，等待切换下来的文件处理完毕
+    };
+
+    // 压缩文件的滚动依据
+    enum class RollMeasure
+    {
+        UNCOMPRESSED = 0, // 按压缩前的字节数
+        COMPRESSED        // 按实际写入磁盘的字节数
+    };
+
+    // 压缩文件落地：每批数据压缩为一个可以独立解压的gzip成员/zstd帧后写入，gzip -dc/zstd -dc可以直接解压整个文件
+    // 同时维护同名的.idx索引文件，每帧一条记录：{压缩后偏移, 压缩前偏移, 压缩前长度}，均为小端uint64，用于按位置跳转解压
+    // 压缩在异步线程中进行，适合配合异步日志器使用；批次很小时（如同步日志器每条日志一帧）压缩率很低，
+    // 此时可以设置min_frame，攒够该大小再压缩成一帧，未压缩的数据在flush、sync与关闭时写出
+    class CompressedFileLogSink : public LogSink
+    {
+    public:
+        // max_size为0表示不滚动
+        CompressedFileLogSink(const std::string &filename, CompressType type = CompressType::GZIP,
+                              size_t max_size = 0, RollMeasure measure = RollMeasure::UNCOMPRESSED,
+                              int level = -1, size_t min_frame = 0)
+            : _filename(filename),
+              _stream(type, level),
+              _max_size(max_size),
+              _measure(measure),
+              _min_frame(min_frame),
+              _raw_size(0),
+              _disk_size(0),
+              _cur_suffix(1)
+        {
+            File::createDirectory(File::getPath(filename));
+        }
+        void log(const char *data, size_t len) override
+        {
+            Fragment frag{data, len};
+            logBatch(&frag, 1);
+        }
+        void logBatch(const Fragment *frags, size_t n) override
+        {
+            if (_pending.empty() && _min_frame == 0)
+            {
+                writeFrame(frags, n);
+                return;
+            }
+            for (size_t i = 0; i < n; ++i)
+                _pending.append(frags[i]._data, frags[i]._len);
+            if (_pending.size() >= _min_frame) flush();
+        }
+        void flush() override
+        {
+            if (_pending.empty()) return;
+            Fragment frag{_pending.data(), _pending.size()};
+            writeFrame(&frag, 1);
+            _pending.clear();
+        }
+        void sync() override
+        {
+            flush();
+            _file.sync();
+            _index.sync();
+        }
+        size_t errors() const override { return _file.errors() + _index.errors(); }
+        size_t lostBytes() const override { return _file.lostBytes(); }
+        ~CompressedFileLogSink()
+        {
+            if (syncEnabled()) sync();
+            else flush();
+        }
+
+    private:
+        void writeFrame(const Fragment *frags, size_t n)
+        {
+            size_t len = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                _stream.write(frags[i]._data, frags[i]._len, _frame);
+                len += frags[i]._len;
+            }
+            if (len == 0) return;
+            _stream.finish(_frame);
+            checkStat();
+            char entry[INDEX_ENTRY_SIZE];
+            putLE64(entry, _disk_size);
+            putLE64(entry + 8, _raw_size);
+            putLE64(entry + 16, len);
+            _file.write(_frame.data(), _frame.size());
+            _index.write(entry, sizeof(entry));
+            _disk_size += _frame.size();
+            _raw_size += len;
+            _frame.clear();
+        }
+        void checkStat()
+        {
+            size_t cur = _measure == RollMeasure::UNCOMPRESSED ? _raw_size : _disk_size;
+            if (_file.isOpen() && (_max_size == 0 || cur < _max_size)) return;
+            //此时当前帧已压缩完但尚未写入，只能同步文件本身，不能经由flush再写一帧
+            if (syncEnabled())
+            {
+                _file.sync();
+                _index.sync();
+            }
+            std::string name = _max_size == 0 ? _filename : newFileName();
+            name += compressSuffix(_stream.type());
+            _file.open(name);
+            _index.open(name + ".idx");
+            //追加到已有文件时，偏移从已有数据的末尾开始
+            std::error_code ec;
+            _disk_size = fs::file_size(name, ec);
+            if (ec) _disk_size = 0;
+            _raw_size = lastRawEnd(name + ".idx");
+        }
+        static uint64_t lastRawEnd(const std::string &index)
+        {
+            std::ifstream ifs(index, std::ios::binary | std::ios::ate);
+            char entry[INDEX_ENTRY_SIZE];
+            if (!ifs.is_open() || (size_t)ifs.tellg() < sizeof(entry)) return 0;
+            ifs.seekg(-(std::streamoff)sizeof(entry), std::ios::end);
+            if (!ifs.read(entry, sizeof(entry))) return 0;
+            return getLE64(entry + 8) + getLE64(entry + 16);
+        }
+
+    public:
+        // 索引文件的读写，与主机字节序无关
+        static const size_t INDEX_ENTRY_SIZE = 24;
+        static void putLE64(char *p, uint64_t value)
+        {
+            for (int i = 0; i < 8; ++i) p[i] = static_cast<char>(value >> (8 * i));
+        }
+        static uint64_t getLE64(const char *p)
+        {
+            uint64_t value = 0;
+            for (int i = 0; i < 8; ++i) value |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+            return value;
+        }
+
+    private:
+        std::string newFileName()
+        {
+            time_t t = logsys::Date::now();
+            struct tm _tm;
+            localtime_r(&t, &_tm);
+            char s[128];
+            strftime(s, 127, "%Y%m%d%H%M%S", &_tm);
+            return _filename + s + "-" + std::to_string(_cur_suffix++);
+        }
+
+    private:
+        std::string _filename;
+        CompressStream _stream;
+        std::string _frame;      // 当前帧的压缩数据
+        LogFile _file;
+        LogFile _index;
+        size_t _max_size;
+        RollMeasure _measure;
+        size_t _min_frame;       // 帧的最小压缩前大小
+        std::string _pending;    // 尚未压缩的数据
+        uint64_t _raw_size;      // 当前文件压缩前的字节数
+        uint64_t _disk_size;     // 当前文件压缩后的字节数
+        size_t _cur_suffix;
+    };
+
+    // 独立落地：为被包装的落地方向提供独立的线程与队列，慢速落地（网络文件系统、阻塞的管道）
+    // 只会积压自己的队列，不会拖慢日志器与其他落地方向
+    // 日志器把每批数据拷贝一次放入引用计数的缓冲区，由所有独立落地共享；持久化策略应设置在被包装的落地方向上
+    class AsyncLogSink : public LogSink
+    {
+    public:
+        using ptr = std::shared_ptr<AsyncLogSink>;
+        using Data = std::shared_ptr<const std::string>;
+        // 队列状态，用于观察落地方向的积压情况
+        struct Stat
+        {
+            size_t _pending_bytes;              // 队列中尚未落地的字节数
+            size_t _pending_batches;
+            std::chrono::nanoseconds _lag;      // 队首数据已等待的时间
+            size_t _dropped_bytes;              // 按溢出策略丢弃的字节数
+            size_t _dropped_batches;
+        };
+
+    public:
+        // capacity为队列中允许积压的字节数，超出后按溢出策略处理（GROW表示不限制）
+        AsyncLogSink(const LogSink::ptr &sink, size_t capacity = ASYNC_SINK_CAPACITY,
+                     const OverflowOption &option = OverflowOption())
+            : _sink(sink),
+              _capacity(capacity),
+              _option(option),
+              _running(true),
+              _pending(0),
+              _push_cnt(0),
+              _done_cnt(0),
+              _dropped_bytes(0),
+              _dropped_batches(0),
+              _worker(&AsyncLogSink::loop, this)
+        {
+        }
+        ~AsyncLogSink()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _running = false;
+            }
+            _pop_cond.notify_all();
+            _worker.join();
+        }
+        void log(const char *data, size_t len) override
+        {
+            push(std::make_shared<const std::string>(data, len), Level::UNKNOW);
+        }
+        void logBatch(const Fragment *frags, size_t n) override
+        {
+            auto data = std::make_shared<std::string>();
+            for (size_t i = 0; i < n; ++i) data->append(frags[i]._data, frags[i]._len);
+            push(data, Level::UNKNOW);
+        }
+        // 日志器使用：放入共享的一批数据，level为该批日志的最高等级
+        bool push(const Data &data, Level level)
+        {
+            if (data->empty()) return true;
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                if (!ensureSpace(lock, data->size(), level))
+                {
+                    _dropped_bytes += data->size();
+                    ++_dropped_batches;
+                    return false;
+                }
+                _queue.push_back({data, level, std::chrono::steady_clock::now()});
+                _pending += data->size();
+                ++_push_cnt;
+            }
+            _pop_cond.notify_one();
+            return true;
+        }
+        // 阻塞直到调用前放入的数据全部交给被包装的落地方向
+        void flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            size_t target = _push_cnt;
+            _flush_cond.wait(lock, [&](){return _done_cnt >= target;});
+        }
+        void sync() override { flush(); }
+        size_t errors() const override { return _sink->errors(); }
+        size_t lostBytes() const override { return _sink->lostBytes(); }
+        Stat stat()
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            auto lag = _queue.empty() ? std::chrono::nanoseconds(0) : std::chrono::steady_clock::now() - _queue.front()._time;
+            return {_pending, _queue.size(), lag, _dropped_bytes, _dropped_batches};
+        }
+
+    private:
+        struct Item
+        {
+            Data _data;
+            Level _level;
+            std::chrono::steady_clock::time_point _time; // 入队时间
+        };
+        // 与AsyncLooper的溢出处理一致，调用者需持有锁
+        bool ensureSpace(std::unique_lock<std::mutex> &lock, size_t len, Level level)
+        {
+            auto enough = [&](){return _pending + len <= _capacity || _queue.empty();};
+            if (enough()) return true;
+            switch (_option._policy)
+            {
+            case OverflowPolicy::GROW:
+                return true;
+            case OverflowPolicy::DROP_NEWEST:
+                return false;
+            case OverflowPolicy::DROP_OLDEST:
+                //正在落地的数据已出队，队列中的数据都可以丢弃
+                while (!_queue.empty() && !enough())
+                {
+                    _pending -= _queue.front()._data->size();
+                    _dropped_bytes += _queue.front()._data->size();
+                    ++_dropped_batches;
+                    ++_done_cnt;
+                    _queue.pop_front();
+                }
+                _flush_cond.notify_all();
+                return true;
+            case OverflowPolicy::DROP_BELOW_LEVEL:
+                if (level < _option._drop_level) return false;
+                [[fallthrough]];
+            default:
+                if (_option._timeout == 0)
+                {
+                    _push_cond.wait(lock, enough);
+                    return true;
+                }
+                return _push_cond.wait_for(lock, std::chrono::milliseconds(_option._timeout), enough);
+            }
+        }
+        // 每次取出队列中的全部数据，一次批量落地、一次持久化检查
+        void loop()
+        {
+            std::vector<Item> items;
+            std::vector<Fragment> frags;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mtx);
+                    //被包装的落地方向有待按时间同步的数据时，空闲等待到截止时间为止
+                    auto ready = [&](){return !_queue.empty() || !_running;};
+                    auto deadline = _sink->syncDeadline();
+                    if (deadline == std::chrono::steady_clock::time_point::max()) _pop_cond.wait(lock, ready);
+                    else if (!_pop_cond.wait_until(lock, deadline, ready))
+                    {
+                        lock.unlock();
+                        _sink->syncIfDue();
+                        continue;
+                    }
+                    if (_queue.empty()) return;
+                    items.assign(std::make_move_iterator(_queue.begin()), std::make_move_iterator(_queue.end()));
+                    _queue.clear();
+                }
+                size_t len = 0;
+                Level level = Level::UNKNOW;
+                frags.clear();
+                for (auto &item : items)
+                {
+                    frags.push_back({item._data->data(), item._data->size()});
+                    len += item._data->size();
+                    if (level < item._level) level = item._level;
+                }
+                _sink->logBatch(frags.data(), frags.size());
+                _sink->commit(len, level);
+                {
+                    std::unique_lock<std::mutex> lock(_mtx);
+                    _pending -= len;
+                    _done_cnt += items.size();
+                }
+                items.clear();
+                _push_cond.notify_all();
+                _flush_cond.notify_all();
+            }
+        }
+
+    private:
+        LogSink::ptr _sink;
+        size_t _capacity;
+        OverflowOption _option;
+        bool _running;
+        std::mutex _mtx;
+        std::condition_variable _push_cond;
+        std::condition_variable _pop_cond;
+        std::condition_variable _flush_cond;
+        std::deque<Item> _queue;
+        size_t _pending;         // 队列与正在落地的数据的字节数
+        size_t _push_cnt;        // 已入队的批数
+        size_t _done_cnt;        // 已落地或被丢弃的批数
+        size_t _dropped_bytes;
+        size_t _dropped_batches;
+        std::thread _worker;     // 必须最后初始化
     };
 
     template <class T, class... Args>
@@ -140,7 +1021,7 @@ namespace log
 };
 
 // 扩展模块自定义区域
-namespace log
+namespace logsys
 {
     enum class gaptype
     {
@@ -192,9 +1073,19 @@ namespace log
         void log(const char *data, size_t len) override
         {
             checkStat(Date::now());
-            _ofs.write(data, len);
-            assert(_ofs.good());
+            _file.write(data, len);
+        }
+        void logBatch(const Fragment *frags, size_t n) override
+        {
+            checkStat(Date::now());
+            _file.write(frags, n);
         }
+        void sync() override
+        {
+            _file.sync();
+        }
+        size_t errors() const override { return _file.errors(); }
+        size_t lostBytes() const override { return _file.lostBytes(); }
         void checkStat(time_t t)
         {
             // 若继续写文件会导致长度溢出，则需要重新开一个文件
@@ -209,17 +1100,23 @@ namespace log
                 _last_time = _last_time == 0? t: _last_time + _time_gap;
                 create_new_file = true;
             }
-            if (!_ofs.is_open() || create_new_file)
+            if (!_file.isOpen() || create_new_file)
             {
-                _ofs.close();
-                std::string new_file_name = newFileName();
-                _ofs.open(new_file_name, std::ios::app | std::ios::binary);
-                assert(_ofs.is_open());
+                if (syncEnabled()) _file.sync();
+                std::string old_file = _cur_file;
+                _cur_file = newFileName();
+                _file.open(_cur_file);
+                if (_archiver && !old_file.empty() && old_file != _cur_file) _archiver->push(old_file, _cur_file);
             }
         }
+        // 启用归档：切换下来的文件在后台压缩，并按数量、大小、时间清理旧文件
+        void setArchive(const ArchiveOption &option)
+        {
+            _archiver = std::make_shared<Archiver>(_filename, option, false);
+        }
         std::string newFileName()
         {
-            time_t t = log::Date::now();
+            time_t t = logsys::Date::now();
             struct tm _tm;
             #ifdef _WIN32
             localtime_s(&_tm, &t);
@@ -233,16 +1130,18 @@ namespace log
         }
         ~RollByTimeLogSink()
         {
-            _ofs.close();
+            if (syncEnabled()) _file.sync();
         }
 
     private:
         std::string _filename;
-        std::ofstream _ofs;
+        std::string _cur_file; // 当前正在写入的文件
+        LogFile _file;
         size_t _time_gap;
         size_t _last_gap;
         bool _is_by_system; // 是否直接通过系统时间来计算时间间隔，
         // 可能会导致第一时间段的实际时间间隔小于期望时间间隔
         size_t _last_time; // 若不按照系统时间来算，则需要按照时间戳来计算实际时间间隔
+        Archiver::ptr _archiver; // 需最先析构，等待切换下来的文件处理完毕
     };
 }
\ No newline at end of file
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <condition_variable>
+#include "buffer.hpp"
+#include "looper.hpp"
+
+namespace logsys
+{
+    const size_t STAGING_DEFAULT_SIZE = 64 * 1024;
+    const size_t STAGING_DEFAULT_INTERVAL = 50; // 毫秒
+
+    // 线程本地暂存区：每个生产者线程先把日志攒在自己的缓冲区中，
+    // 攒够一定大小、超过一定时间、线程退出或日志器刷新时再整块交给事件循环，
+    // 同一线程的日志始终按顺序提交
+    class Stager : public std::enable_shared_from_this<Stager>
+    {
+    public:
+        using ptr = std::shared_ptr<Stager>;
+
+    private:
+        struct Block
+        {
+            Block(size_t size) : _buffer(size), _last(std::chrono::steady_clock::now()) {}
+            std::mutex _mtx; // 基本只有所属线程使用，仅在定时提交与刷新时才会产生竞争
+            Buffer _buffer;
+            LevelStat _stat; // 暂存日志的等级统计，交给事件循环做溢出处理
+            std::chrono::steady_clock::time_point _last; // 上一次提交的时间
+        };
+        // 每个线程持有的暂存区列表，线程退出时析构并提交剩余数据
+        struct ThreadStaging
+        {
+            struct Entry
+            {
+                size_t _id;
+                std::weak_ptr<Stager> _stager;
+                std::shared_ptr<Block> _block;
+            };
+            std::vector<Entry> _entries;
+            ~ThreadStaging()
+            {
+                for (auto &entry : _entries)
+                {
+                    auto stager = entry._stager.lock();
+                    if (stager) stager->retire(entry._block);
+                }
+            }
+        };
+
+    public:
+        Stager(const Looper::ptr &looper, size_t chunk_size = STAGING_DEFAULT_SIZE,
+               size_t interval_ms = STAGING_DEFAULT_INTERVAL)
+            : _id(nextId()),
+              _looper(looper),
+              _chunk_size(chunk_size),
+              _interval(interval_ms),
+              _running(true)
+        {
+            if (chunk_size == 0) throw std::runtime_error("暂存区大小不能为0");
+            // 参数检查通过后再启动线程，构造失败时不会留下可join的线程
+            _ticker = std::thread(&Stager::tick, this);
+        }
+        ~Stager()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _running = false;
+            }
+            _cond.notify_all();
+            _ticker.join();
+            flush();
+        }
+        void push(const char *data, size_t len, Level level)
+        {
+            Block &block = local();
+            std::unique_lock<std::mutex> lock(block._mtx);
+            block._buffer.push(data, len);
+            block._stat.add(level);
+            if (block._buffer.readAbleSize() >= _chunk_size) publish(block);
+        }
+        // 提交所有线程暂存的数据
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            for (auto &block : _blocks)
+            {
+                std::unique_lock<std::mutex> block_lock(block->_mtx);
+                publish(*block);
+            }
+        }
+
+    private:
+        static size_t nextId()
+        {
+            static std::atomic<size_t> id(0);
+            return ++id;
+        }
+        // 调用者需持有block的锁
+        void publish(Block &block)
+        {
+            block._last = std::chrono::steady_clock::now();
+            if (block._buffer.empty()) return;
+            _looper->push(block._buffer.begin(), block._buffer.readAbleSize(), block._stat);
+            block._buffer.reset();
+            block._stat.clear();
+        }
+        Block &local()
+        {
+            thread_local ThreadStaging staging;
+            //绝大多数线程只使用少量日志器，线性查找即可
+            for (auto &entry : staging._entries)
+                if (entry._id == _id) return *entry._block;
+            //首次使用，顺带清理已销毁日志器的暂存区
+            std::erase_if(staging._entries, [](const ThreadStaging::Entry &entry){ return entry._stager.expired(); });
+            auto block = std::make_shared<Block>(_chunk_size * 2);
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _blocks.push_back(block);
+            }
+            staging._entries.push_back({_id, weak_from_this(), block});
+            return *block;
+        }
+        // 线程退出：提交剩余数据并注销
+        void retire(const std::shared_ptr<Block> &block)
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            {
+                std::unique_lock<std::mutex> block_lock(block->_mtx);
+                publish(*block);
+            }
+            std::erase(_blocks, block);
+        }
+        // 定时提交长时间未达到大小阈值的暂存区，保证日志的延迟有上限
+        void tick()
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            while (_running)
+            {
+                _cond.wait_for(lock, _interval);
+                auto now = std::chrono::steady_clock::now();
+                for (auto &block : _blocks)
+                {
+                    //生产者正在写入则跳过，下一轮再处理
+                    std::unique_lock<std::mutex> block_lock(block->_mtx, std::try_to_lock);
+                    if (block_lock.owns_lock() && now - block->_last >= _interval) publish(*block);
+                }
+            }
+        }
+
+    private:
+        size_t _id;                                // 用于线程本地查找的唯一标识
+        Looper::ptr _looper;
+        size_t _chunk_size;                        // 达到该大小立即提交
+        std::chrono::milliseconds _interval;       // 超过该时间未提交则由定时线程提交
+        std::mutex _mtx;                           // 保护_blocks
+        std::condition_variable _cond;
+        std::vector<std::shared_ptr<Block>> _blocks;
+        bool _running;
+        std::thread _ticker;
+    };
+};
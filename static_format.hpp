@@ -0,0 +1,170 @@
+#pragma once
+
+#include "format.hpp"
+#include <array>
+#include <charconv>
+#include <string_view>
+#include <utility>
+
+// 编译期格式化器：模式串在编译期解析，运行时按固定顺序直接向字符串追加内容，没有虚函数调用与ostream开销
+// 用法：builder->buildFormat(std::make_shared<logsys::StaticFormat<"[%d{%H:%M:%S}][%p] %m%n">>());
+namespace logsys
+{
+    template <size_t N>
+    struct FixedString
+    {
+        char _str[N];
+        constexpr FixedString(const char (&str)[N])
+        {
+            for (size_t i = 0; i < N; ++i) _str[i] = str[i];
+        }
+        constexpr std::string_view view() const { return {_str, N - 1}; }
+    };
+
+    // 解析结果，文本与时间子格式统一存放在_pool中（子格式以'\0'结尾，供strftime使用），P为_pool所需的大小
+    template <size_t N, size_t P>
+    struct CompiledPattern
+    {
+        struct Token
+        {
+            char _key;      // 0表示普通文本
+            size_t _begin;  // 在_pool中的起始位置
+            size_t _len;
+        };
+        std::array<Token, N> _tokens{};
+        size_t _count = 0;
+        std::array<char, P> _pool{};
+        size_t _pool_size = 0;
+
+        constexpr void addText(char c)
+        {
+            if (_count == 0 || _tokens[_count - 1]._key != 0)
+                _tokens[_count++] = {0, _pool_size, 0};
+            _pool[_pool_size++] = c;
+            ++_tokens[_count - 1]._len;
+        }
+        constexpr void addItem(char key, std::string_view sub)
+        {
+            _tokens[_count++] = {key, _pool_size, sub.size()};
+            for (char c : sub) _pool[_pool_size++] = c;
+            _pool[_pool_size++] = '\0';
+        }
+    };
+
+    constexpr std::string_view DEFAULT_TIME_FORMAT = "%H:%M:%S"; // %d未指定子格式时使用
+
+    // 按与compilePattern相同的规则统计_pool需要的大小；不合法的部分也计入，保证报错前不会越界
+    constexpr size_t poolSize(std::string_view pattern)
+    {
+        size_t size = 0;
+        size_t pos = 0;
+        while (pos < pattern.size())
+        {
+            if (pattern[pos++] != '%' || pos == pattern.size())
+            {
+                ++size;
+                continue;
+            }
+            char key = pattern[pos++];
+            if (key == '%' || key == '{')
+            {
+                ++size;
+                continue;
+            }
+            size_t sub = 0;
+            if (pos != pattern.size() && pattern[pos] == '{')
+            {
+                size_t end = pattern.find('}', ++pos);
+                if (end == std::string_view::npos) end = pattern.size();
+                sub = end - pos;
+                pos = end + 1;
+            }
+            if (key == 'd' && sub == 0) sub = DEFAULT_TIME_FORMAT.size();
+            size += sub + 1;
+        }
+        return size;
+    }
+
+    // 与Format::parsePattern规则一致，格式有误时无法通过编译
+    template <size_t N, size_t P>
+    constexpr CompiledPattern<N, P> compilePattern(std::string_view pattern)
+    {
+        CompiledPattern<N, P> ret;
+        size_t pos = 0;
+        while (pos < pattern.size())
+        {
+            if (pattern[pos] != '%')
+            {
+                ret.addText(pattern[pos++]);
+                continue;
+            }
+            if (++pos == pattern.size())
+                throw "expected a formatting character after '%'";
+            //%%与%{视为普通文本
+            if (pattern[pos] == '%' || pattern[pos] == '{')
+            {
+                ret.addText(pattern[pos++]);
+                continue;
+            }
+            char key = pattern[pos++];
+            if (std::string_view("dTtpcflmn").find(key) == std::string_view::npos)
+                throw "not a formatting character";
+            std::string_view sub;
+            if (pos != pattern.size() && pattern[pos] == '{')
+            {
+                size_t end = pattern.find('}', ++pos);
+                if (end == std::string_view::npos)
+                    throw "expected '}' after '{'";
+                sub = pattern.substr(pos, end - pos);
+                pos = end + 1;
+            }
+            if (key == 'd' && sub.empty()) sub = DEFAULT_TIME_FORMAT;
+            ret.addItem(key, sub);
+        }
+        return ret;
+    }
+
+    template <FixedString Pattern>
+    class StaticFormat : public Format
+    {
+    public:
+        StaticFormat() : Format(std::string(Pattern.view())) {}
+        using Format::format;
+        void format(std::string &out, const LogMsg &msg) override
+        {
+            formatAll(out, msg, std::make_index_sequence<_compiled._count>());
+        }
+
+    private:
+        static constexpr auto _compiled = compilePattern<sizeof(Pattern._str), poolSize(Pattern.view())>(Pattern.view());
+
+        template <size_t... I>
+        static void formatAll(std::string &out, const LogMsg &msg, std::index_sequence<I...>)
+        {
+            (formatItem<_compiled._tokens[I]._key, _compiled._tokens[I]._begin, _compiled._tokens[I]._len>(out, msg), ...);
+        }
+        template <char Key, size_t Begin, size_t Len>
+        static void formatItem(std::string &out, const LogMsg &msg)
+        {
+            if constexpr (Key == 0) out.append(_compiled._pool.data() + Begin, Len);
+            else if constexpr (Key == 'd')
+            {
+                //时间格式化需要按秒缓存，复用TimeFormatItem的实现（直接调用，不经过虚函数）
+                static TimeFormatItem item(std::string(_compiled._pool.data() + Begin, Len));
+                item.TimeFormatItem::format(out, msg);
+            }
+            else if constexpr (Key == 'T') out += '\t';
+            else if constexpr (Key == 't') out += threadIdString(msg._tid);
+            else if constexpr (Key == 'p') out += toStringView(msg._level);
+            else if constexpr (Key == 'c') out += msg._name;
+            else if constexpr (Key == 'f') out += msg._file;
+            else if constexpr (Key == 'l')
+            {
+                char s[24];
+                out.append(s, std::to_chars(s, s + sizeof(s), msg._line).ptr - s);
+            }
+            else if constexpr (Key == 'm') out += msg._payload;
+            else if constexpr (Key == 'n') out += '\n';
+        }
+    };
+};
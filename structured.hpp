@@ -0,0 +1,194 @@
+#pragma once
+
+#include "format.hpp"
+#include <string>
+#include <string_view>
+#include <charconv>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 结构化格式化器：每条日志输出一个JSON对象或一行logfmt，包含时间、等级、日志器、文件、行号、线程、消息
+// 以及日志调用中以logsys::kv(key, value)传入的字段，下游索引无需再用正则解析文本
+// 用法：builder->buildFormat(std::make_shared<logsys::StructuredFormat>(logsys::StructuredType::JSON));
+namespace logsys
+{
+    enum class StructuredType
+    {
+        JSON = 0,
+        LOGFMT
+    };
+
+    // JSON字符串转义：引号、反斜杠与控制字符，其余字节（包括UTF-8多字节字符）原样输出
+    class JsonEscaper
+    {
+    public:
+        static void append(std::string &out, std::string_view str)
+        {
+            const char *p = str.data();
+            const char *end = p + str.size();
+            while (p < end)
+            {
+                size_t n = plainPrefix(p, end);
+                out.append(p, n);
+                p += n;
+                if (p == end) break;
+                escape(out, *p++);
+            }
+        }
+
+    private:
+        static bool plain(char c)
+        {
+            return static_cast<unsigned char>(c) >= 0x20 && c != '"' && c != '\\';
+        }
+        // 开头无需转义的字节数，SSE2每次检查16个字节
+        static size_t plainPrefix(const char *begin, const char *end)
+        {
+            const char *p = begin;
+#if defined(__SSE2__)
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i control = _mm_set1_epi8(0x1f);
+            for (; end - p >= 16; p += 16)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+                //无符号比较v <= 0x1f等价于max(v, 0x1f) == 0x1f
+                __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                               _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+                int mask = _mm_movemask_epi8(special);
+                if (mask) return p - begin + __builtin_ctz(mask);
+            }
+#endif
+            while (p < end && plain(*p)) ++p;
+            return p - begin;
+        }
+        static void escape(std::string &out, char c)
+        {
+            switch (c)
+            {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            default:
+            {
+                const char *hex = "0123456789abcdef";
+                char s[6] = {'\\', 'u', '0', '0', hex[(c >> 4) & 0xf], hex[c & 0xf]};
+                out.append(s, sizeof(s));
+            }
+            }
+        }
+    };
+
+    class StructuredFormat : public Format
+    {
+    public:
+        // time_format为时间字段的格式，规则与%d{...}相同
+        StructuredFormat(StructuredType type = StructuredType::JSON,
+                         const std::string &time_format = "%Y-%m-%dT%H:%M:%S.%6N%z")
+            : Format("%m"), _type(type), _time(time_format) {}
+        using Format::format;
+        void format(std::string &out, const LogMsg &msg) override
+        {
+            if (_type == StructuredType::JSON) formatJson(out, msg);
+            else formatLogfmt(out, msg);
+            out += '\n';
+        }
+
+    private:
+        void formatJson(std::string &out, const LogMsg &msg)
+        {
+            out += "{\"time\":\"";
+            _time.format(out, msg);
+            out += "\",\"level\":\"";
+            out += toStringView(msg._level);
+            out += "\",\"logger\":\"";
+            JsonEscaper::append(out, msg._name);
+            out += "\",\"file\":\"";
+            JsonEscaper::append(out, msg._file);
+            out += "\",\"line\":";
+            appendNumber(out, msg._line);
+            out += ",\"thread\":\"";
+            out += threadIdString(msg._tid);
+            out += "\",\"msg\":\"";
+            JsonEscaper::append(out, msg._payload);
+            out += '"';
+            for (auto &field : msg._fields)
+            {
+                out += ",\"";
+                JsonEscaper::append(out, field._key);
+                out += "\":";
+                if (!field._quoted)
+                {
+                    out += field._value;
+                    continue;
+                }
+                out += '"';
+                JsonEscaper::append(out, field._value);
+                out += '"';
+            }
+            out += '}';
+        }
+        void formatLogfmt(std::string &out, const LogMsg &msg)
+        {
+            out += "time=";
+            _time.format(out, msg);
+            out += " level=";
+            out += toStringView(msg._level);
+            out += " logger=";
+            appendValue(out, msg._name);
+            out += " file=";
+            appendValue(out, msg._file);
+            out += " line=";
+            appendNumber(out, msg._line);
+            out += " thread=";
+            out += threadIdString(msg._tid);
+            //消息总是加引号，便于下游区分
+            out += " msg=\"";
+            JsonEscaper::append(out, msg._payload);
+            out += '"';
+            //键来自用户传入的kv，同样按值的规则加引号转义，避免空格、等号或换行破坏整行的解析
+            for (auto &field : msg._fields)
+            {
+                out += ' ';
+                appendValue(out, field._key);
+                out += '=';
+                appendValue(out, field._value);
+            }
+        }
+        // logfmt的键与值只在包含空白、等号、引号、控制字符或为空时才加引号
+        static void appendValue(std::string &out, std::string_view value)
+        {
+            bool quote = value.empty();
+            for (char c : value)
+            {
+                if (static_cast<unsigned char>(c) <= ' ' || c == '=' || c == '"' || c == '\\')
+                {
+                    quote = true;
+                    break;
+                }
+            }
+            if (!quote)
+            {
+                out += value;
+                return;
+            }
+            out += '"';
+            JsonEscaper::append(out, value);
+            out += '"';
+        }
+        static void appendNumber(std::string &out, size_t value)
+        {
+            char s[24];
+            out.append(s, std::to_chars(s, s + sizeof(s), value).ptr - s);
+        }
+
+    private:
+        StructuredType _type;
+        TimeFormatItem _time;
+    };
+};
@@ -1,14 +1,352 @@
 #include <iostream>
 #include <chrono>
+#include <sstream>
 #include "format.hpp"
 #include "sink.hpp"
 #include "logger.hpp"
+#include "structured.hpp"
 #include "test_util/file_cmp.hpp"
+#include "test_util/alloc_count.hpp"
+#include "test_util/frame_decode.hpp"
 #include "buffer.hpp"
 using namespace std;
 using namespace this_thread;
 using namespace chrono_literals;
 
+// 稳定状态下，日志调用线程的每次调用都不应分配内存
+static bool checkAllocations()
+{
+    bool ok = true;
+    for (bool deferred : {false, true})
+    for (auto type : {logsys::LoggerType::LOGGER_SYNC, logsys::LoggerType::LOGGER_ASYNC})
+    {
+        logsys::LocalLoggerBuilder builder;
+        builder.buildLoggerName("alloc");
+        builder.buildType(type);
+        builder.buildDeferredFormat(deferred);
+        // 缓冲区按需增长，容量较小时预热期间即可增长到上限，此后不再分配
+        builder.buildBufferSize(64 * 1024);
+        builder.buildSink<logsys::NullLogSink>();
+        logsys::Logger::ptr logger = builder.build();
+        string payload(100, 'x');
+        auto once = [&](size_t i) {
+            LOG_INFO(logger, "steady state message {} {} {}", i, payload, 3.14);
+            logger->info(__FILE__, __LINE__, "legacy call {} {}", i, payload);
+        };
+        // 预热：线程本地缓冲区与缓存达到稳定容量
+        for (size_t i = 0; i < 1000; ++i) once(i);
+        logger->flush();
+        logsys::test_util::AllocCount counter;
+        for (size_t i = 0; i < 10000; ++i) once(i);
+        size_t count = counter.count();
+        logger->flush();
+        cout << (type == logsys::LoggerType::LOGGER_SYNC ? "sync" : "async") << (deferred ? " deferred" : "")
+             << ": " << count << " allocations in 20000 calls" << endl;
+        ok = ok && count == 0;
+    }
+    return ok;
+}
+
+static string readFile(const string &name)
+{
+    ifstream ifs(name, ios::binary);
+    return string(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+}
+
+// 压缩文件整体可以解压，且按索引截取的每一帧都能单独解压出对应区间的原始数据；content为整个文件解压后的数据
+static bool checkFrameFile(logsys::CompressType type, const string &file, string &content)
+{
+    using Sink = logsys::CompressedFileLogSink;
+    string disk = readFile(file), index = readFile(file + ".idx");
+    size_t frames = index.size() / Sink::INDEX_ENTRY_SIZE;
+    bool good = logsys::test_util::FrameDecode::decode(type, disk, content) && frames > 0 &&
+                index.size() == frames * Sink::INDEX_ENTRY_SIZE;
+    uint64_t raw_end = 0;
+    for (size_t i = 0; good && i < frames; ++i)
+    {
+        const char *entry = index.data() + i * Sink::INDEX_ENTRY_SIZE;
+        uint64_t offset = Sink::getLE64(entry), raw_offset = Sink::getLE64(entry + 8), len = Sink::getLE64(entry + 16);
+        uint64_t end = i + 1 < frames ? Sink::getLE64(entry + Sink::INDEX_ENTRY_SIZE) : disk.size();
+        string frame;
+        good = raw_offset == raw_end && offset <= end && end <= disk.size() &&
+               logsys::test_util::FrameDecode::decode(type, disk.substr(offset, end - offset), frame) &&
+               frame == content.substr(raw_offset, len);
+        raw_end = raw_offset + len;
+    }
+    return good && raw_end == content.size();
+}
+
+// 不滚动的单个文件，以及启用持久化策略、攒帧并按大小滚动的多个文件
+static bool checkCompressedIndex()
+{
+    using Sink = logsys::CompressedFileLogSink;
+    bool ok = true;
+    for (auto type : {logsys::CompressType::NONE, logsys::CompressType::GZIP})
+    for (bool rolling : {false, true})
+    {
+        string type_name = type == logsys::CompressType::NONE ? "none" : "gzip";
+        if (rolling) type_name += ", sync + rolling";
+        if (!logsys::test_util::FrameDecode::supported(type))
+        {
+            cout << "frame index (" << type_name << "): skipped" << endl;
+            continue;
+        }
+        string dir = "./Draft/frames";
+        fs::remove_all(dir);
+        string name = dir + "/frames.log";
+        string raw;
+        {
+            Sink sink(name, type, rolling ? 2 * 1024 : 0, logsys::RollMeasure::UNCOMPRESSED, -1, rolling ? 1024 : 0);
+            if (rolling) sink.setSync({false, 1, 0, logsys::Level::OFF});
+            for (size_t batch = 0; batch < 8; ++batch)
+            {
+                string data;
+                for (size_t i = 0; i < 50; ++i) data += format("batch {} line {} {}\n", batch, i, string(i % 7, 'x'));
+                sink.log(data.data(), data.size());
+                sink.commit(data.size(), logsys::Level::INFO);
+                raw += data;
+            }
+        }
+        // 滚动生成的文件名以递增的序号结尾，按序号拼接后应与写入的数据相同
+        vector<pair<size_t, string>> files;
+        for (auto &entry : fs::directory_iterator(dir))
+        {
+            string file = entry.path().string();
+            if (file.ends_with(".idx")) continue;
+            string stem = file.substr(0, file.size() - strlen(logsys::compressSuffix(type)));
+            size_t dash = stem.rfind('-');
+            files.push_back({rolling && dash != string::npos ? stoul(stem.substr(dash + 1)) : 0, file});
+        }
+        sort(files.begin(), files.end());
+        bool good = rolling ? files.size() > 1 : files.size() == 1 && files[0].second == name + logsys::compressSuffix(type);
+        string all;
+        for (auto &[seq, file] : files)
+        {
+            string content;
+            good = good && checkFrameFile(type, file, content);
+            all += content;
+        }
+        good = good && all == raw;
+        cout << "frame index (" << type_name << "): " << (good ? "ok" : "FAILED") << endl;
+        ok = ok && good;
+        fs::remove_all(dir);
+    }
+    return ok;
+}
+
+// 二进制日志按同一格式解码后与直接输出的文本逐字节相同，文件末尾不完整的记录不会被解码
+static bool checkBinaryRoundTrip()
+{
+    string dir = "./Draft/binary";
+    fs::remove_all(dir);
+    string pattern = "[%d{%Y-%m-%d %H:%M:%S.%6N}][%t][%p][%c][%f:%l] %m%n";
+    {
+        logsys::LocalLoggerBuilder builder;
+        builder.buildLoggerName("binary");
+        builder.buildType(logsys::LoggerType::LOGGER_ASYNC);
+        builder.buildFormat(pattern);
+        builder.buildSink<logsys::BinaryFileLogSink>(dir + "/log.bin");
+        builder.buildSink<logsys::FixedFileLogSink>(dir + "/log.txt");
+        logsys::Logger::ptr logger = builder.build();
+        string str = "string";
+        for (int i = 0; i < 100; ++i)
+        {
+            LOG_INFO(logger, "ints {} {} {} {} {}", i, -i, (uint64_t)i << 40, (int8_t)-i, (unsigned short)i);
+            LOG_WARNING(logger, "floats {} {:.3f} {}", 1.5f * i, -2.25 * i, (long double)i / 3);
+            LOG_ERROR(logger, "text {} {} {} {} {}", str, "literal", string_view(str).substr(i % 6), 'c', i % 2 == 0);
+            LOG_DEBUG(logger, "pointer {} kv {}", (const void *)&str, logsys::kv("key", i));
+            logger->info(__FILE__, __LINE__, "legacy {:>8} {}", i, str);
+        }
+        logger->flush();
+    }
+    string bin = readFile(dir + "/log.bin"), text = readFile(dir + "/log.txt");
+    logsys::Format format(pattern);
+    string out;
+    bool good = !text.empty() && logsys::BinaryDecoder().render(bin.data(), bin.size(), format, out) == bin.size() &&
+                out == text;
+    // 截掉最后一条记录的末尾，解码停在它之前，已解码部分仍是完整文本的前缀
+    string partial;
+    size_t consumed = logsys::BinaryDecoder().render(bin.data(), bin.size() - 3, format, partial);
+    good = good && consumed < bin.size() - 3 && partial.size() < text.size() && text.starts_with(partial);
+    cout << "binary round trip: " << (good ? "ok" : "FAILED") << endl;
+    fs::remove_all(dir);
+    return good;
+}
+
+// 令牌桶的突发容量与溢出边界；EveryN放行的日志带出被拦下的条数
+static bool checkRateLimit()
+{
+    size_t passed = 0;
+    logsys::TokenBucket slow(1, 5);
+    for (int i = 0; i < 100; ++i) passed += slow.allow();
+    bool good = passed == 5;
+    // per_second<=0时间隔饱和，突发容量再大也不会溢出成负数而全部放行
+    passed = 0;
+    logsys::TokenBucket never(0, 1000);
+    for (int i = 0; i < 100; ++i) passed += never.allow();
+    good = good && passed == 1;
+    passed = 0;
+    logsys::TokenBucket tiny(1e-12, 1000);
+    for (int i = 0; i < 100; ++i) passed += tiny.allow();
+    good = good && passed == 1;
+    passed = 0;
+    logsys::TokenBucket fast(1e12, 1);
+    for (int i = 0; i < 100; ++i) passed += fast.allow();
+    good = good && passed == 100;
+
+    string dir = "./Draft/ratelimit";
+    fs::remove_all(dir);
+    {
+        logsys::LocalLoggerBuilder builder;
+        builder.buildLoggerName("ratelimit");
+        builder.buildFormat("%m%n");
+        builder.buildSink<logsys::FixedFileLogSink>(dir + "/log.txt");
+        logsys::Logger::ptr logger = builder.build();
+        for (int i = 0; i < 25; ++i)
+            LOG_EVERY_N(logger, logsys::Level::INFO, 2, 10, "every {}", i);
+        logger->flush();
+    }
+    good = good && readFile(dir + "/log.txt") == "every 0\nevery 1\nevery 11 [9 suppressed]\nevery 21 [9 suppressed]\n";
+    cout << "rate limit: " << (good ? "ok" : "FAILED") << endl;
+    fs::remove_all(dir);
+    return good;
+}
+
+// 合并重复日志：第一条立即输出，其后的重复汇总为一条，结果与后台线程的分批方式无关
+static bool checkCollapse()
+{
+    string dir = "./Draft/collapse";
+    fs::remove_all(dir);
+    {
+        logsys::LocalLoggerBuilder builder;
+        builder.buildLoggerName("collapse");
+        builder.buildType(logsys::LoggerType::LOGGER_ASYNC);
+        builder.buildCollapseDuplicates(true, 0);
+        builder.buildFormat("%m%n");
+        builder.buildSink<logsys::FixedFileLogSink>(dir + "/log.txt");
+        logsys::Logger::ptr logger = builder.build();
+        for (int i = 0; i < 3; ++i) LOG_INFO(logger, "dup");
+        logger->flush();
+        for (int i = 0; i < 100000; ++i) LOG_INFO(logger, "same {}", 7);
+        LOG_INFO(logger, "other");
+        for (int i = 0; i < 2; ++i) LOG_INFO(logger, "tail");
+    }
+    vector<string> lines;
+    istringstream in(readFile(dir + "/log.txt"));
+    for (string line; getline(in, line);) lines.push_back(line);
+    // 最后一段由析构输出
+    bool good = lines.size() == 7 && lines[0] == "dup" && lines[1].starts_with("dup [repeated 2 times, last at ") &&
+                lines[2] == "same 7" && lines[3].starts_with("same 7 [repeated 99999 times, last at ") &&
+                lines[4] == "other" && lines[5] == "tail" && lines[6].starts_with("tail [repeated 1 times, last at ");
+    // 持续的重复每max_repeats条汇总一次，停止后不等flush，由定时器在间隔到达时输出剩余的汇总
+    fs::remove_all(dir);
+    {
+        logsys::LocalLoggerBuilder builder;
+        builder.buildLoggerName("collapse_bounded");
+        builder.buildType(logsys::LoggerType::LOGGER_ASYNC);
+        builder.buildCollapseDuplicates(true, 50, 1000);
+        builder.buildFormat("%m%n");
+        builder.buildSink<logsys::FixedFileLogSink>(dir + "/log.txt");
+        logsys::Logger::ptr logger = builder.build();
+        for (int i = 0; i < 2500; ++i) LOG_INFO(logger, "storm");
+        sleep_for(300ms);
+        lines.clear();
+        istringstream in(readFile(dir + "/log.txt"));
+        for (string line; getline(in, line);) lines.push_back(line);
+    }
+    size_t repeated = 0;
+    bool bounded = lines.size() >= 4 && lines[0] == "storm";
+    for (size_t i = 1; bounded && i < lines.size(); ++i)
+    {
+        size_t count = 0;
+        bounded = sscanf(lines[i].c_str(), "storm [repeated %zu times, last at ", &count) == 1 && count <= 1000;
+        repeated += count;
+    }
+    good = good && bounded && repeated == 2499;
+    cout << "collapse duplicates: " << (good ? "ok" : "FAILED") << endl;
+    fs::remove_all(dir);
+    return good;
+}
+
+// 写入与同步失败（/dev/full写入时ENOSPC，同步时EINVAL）会被计数，丢失的字节数与写入的数据一致
+static bool checkIoErrors()
+{
+    string data = "lost line\n";
+    vector<logsys::LogSink::ptr> sinks{logsys::sinkCreate<logsys::FixedFileLogSink>("/dev/full"),
+                                       logsys::sinkCreate<logsys::UringFileLogSink>("/dev/full"),
+                                       logsys::sinkCreate<logsys::MmapFileLogSink>("/dev/full")};
+    bool good = true;
+    for (auto &sink : sinks)
+    {
+        sink->log(data.data(), data.size());
+        sink->sync();
+        good = good && sink->errors() == 2 && sink->lostBytes() == data.size();
+    }
+    cout << "io errors: " << (good ? "ok" : "FAILED") << endl;
+    return good;
+}
+
+// 多个异步日志器共享一个后台线程池：flush返回时各自的输出完整且有序；全局日志器不能重复注册
+static bool checkBackendPool()
+{
+    string dir = "./Draft/pool";
+    fs::remove_all(dir);
+    auto pool = make_shared<logsys::BackendPool>(2);
+    vector<logsys::Logger::ptr> loggers;
+    for (int i = 0; i < 4; ++i)
+    {
+        logsys::GlobalLoggerBuilder builder;
+        builder.buildLoggerName("pool_" + to_string(i));
+        builder.buildType(logsys::LoggerType::LOGGER_ASYNC);
+        builder.buildBackendPool(pool);
+        builder.buildFormat("%m%n");
+        builder.buildSink<logsys::FixedFileLogSink>(dir + "/log_" + to_string(i) + ".txt");
+        loggers.push_back(builder.build());
+    }
+    const int count = 5000;
+    for (int j = 0; j < count; ++j)
+        for (int i = 0; i < 4; ++i) LOG_INFO(loggers[i], "{} {}", i, j);
+    bool good = true;
+    for (int i = 0; i < 4; ++i)
+    {
+        loggers[i]->flush();
+        string expect;
+        for (int j = 0; j < count; ++j) expect += format("{} {}\n", i, j);
+        good = good && readFile(dir + "/log_" + to_string(i) + ".txt") == expect &&
+               logsys::getLogger("pool_" + to_string(i)) == loggers[i];
+    }
+    bool thrown = false;
+    try
+    {
+        logsys::GlobalLoggerBuilder builder;
+        builder.buildLoggerName("pool_0");
+        builder.buildSink<logsys::NullLogSink>();
+        builder.build();
+    }
+    catch (const runtime_error &)
+    {
+        thrown = true;
+    }
+    good = good && thrown && logsys::getLogger("pool_0") == loggers[0];
+    cout << "backend pool: " << (good ? "ok" : "FAILED") << endl;
+    fs::remove_all(dir);
+    return good;
+}
+
+// logfmt的键中含有空格、等号、引号或换行时与值一样加引号转义，整行仍能被正确切分
+static bool checkLogfmtKeys()
+{
+    logsys::StructuredFormat format(logsys::StructuredType::LOGFMT);
+    logsys::LogMsg msg("logfmt", "test.cc", 1, "hi", logsys::Level::INFO);
+    msg._fields.push_back({"bad key=\"x\n", "1", false});
+    msg._fields.push_back({"ok", "v w", true});
+    string out;
+    format.format(out, msg);
+    bool good = out.ends_with(" \"bad key=\\\"x\\n\"=1 ok=\"v w\"\n") && out.find('\n') == out.size() - 1;
+    cout << "logfmt keys: " << (good ? "ok" : "FAILED") << endl;
+    return good;
+}
+
 int main()
 {
     // std::ifstream ifs("./Draft/logfile/test.txt", std::ios::binary);
@@ -19,7 +357,7 @@ int main()
     // body.resize(fsize);
     // ifs.read(&body.front(), fsize);
     // ifs.close();
-    // log::Buffer buffer;
+    // logsys::Buffer buffer;
     // for(int i = 0; i < fsize; ++i)
     // {
     //     buffer.push(body.data() + i, 1);
@@ -33,28 +371,28 @@ int main()
     // ofs.close();
     // std::ifstream ifs1("./Draft/logfile/test.txt", std::ios::binary);
     // std::ifstream ifs2("./Draft/logfile/tmp.txt", std::ios::binary);
-    // log::test_util::FileCmp::file_cmp(ifs1, ifs2);
-    // log::Format::ptr fmt(new log::Format("test%%[test1][%T%d%{][%t][%p][%c][%f:%l] %m%n"));
-    // log::LogMsg msg("ljx", "test.cc", 8, "This is just a test", log::Level::INFO);
-    // log::LogSink::ptr out_sink = log::sinkCreate<log::StdOutLogSink>();
-    // log::LogSink::ptr fixed_sink = log::sinkCreate<log::FixedFileLogSink>("./Draft/logfile/test.txt");
-    // log::LogSink::ptr rolling_sink = log::sinkCreate<log::RollBySizeLogSink>\
+    // logsys::test_util::FileCmp::file_cmp(ifs1, ifs2);
+    // logsys::Format::ptr fmt(new logsys::Format("test%%[test1][%T%d%{][%t][%p][%c][%f:%l] %m%n"));
+    // logsys::LogMsg msg("ljx", "test.cc", 8, "This is just a test", logsys::Level::INFO);
+    // logsys::LogSink::ptr out_sink = logsys::sinkCreate<logsys::StdOutLogSink>();
+    // logsys::LogSink::ptr fixed_sink = logsys::sinkCreate<logsys::FixedFileLogSink>("./Draft/logfile/test.txt");
+    // logsys::LogSink::ptr rolling_sink = logsys::sinkCreate<logsys::RollBySizeLogSink>\
     // ("./Draft/logfile/test.txt", 1024 * 1024, true);
-    // log::LogSink::ptr roll_by_time = log::sinkCreate<log::RollByTimeLogSink>("./Draft/logfile/test.txt", 20, false);
-    // vector<log::LogSink::ptr> sinks{out_sink, fixed_sink, rolling_sink, roll_by_time};
-    // // vector<log::LogSink::ptr> sinks{out_sink};
-    // log::SyncLogger synlogger("synlogger", fmt, sinks, log::Level::DEBUG);
+    // logsys::LogSink::ptr roll_by_time = logsys::sinkCreate<logsys::RollByTimeLogSink>("./Draft/logfile/test.txt", 20, false);
+    // vector<logsys::LogSink::ptr> sinks{out_sink, fixed_sink, rolling_sink, roll_by_time};
+    // // vector<logsys::LogSink::ptr> sinks{out_sink};
+    // logsys::SyncLogger synlogger("synlogger", fmt, sinks, logsys::Level::DEBUG);
 
-    unique_ptr<log::LocalLoggerBuilder> builder(new log::LocalLoggerBuilder());
-    builder->buildLimitLevel(log::Level::DEBUG);
+    unique_ptr<logsys::LocalLoggerBuilder> builder(new logsys::LocalLoggerBuilder());
+    builder->buildLimitLevel(logsys::Level::DEBUG);
     builder->buildLoggerName("root");
-    builder->buildType(log::LoggerType::LOGGER_ASYNC);
-    builder->buildSink<log::StdOutLogSink>();
-    builder->buildSink<log::FixedFileLogSink>("./Draft/logfile/test.txt");
-    builder->buildSink<log::RollBySizeLogSink>("./Draft/logfile/test.txt", 1024 * 1024, true, false);
-    builder->buildSink<log::RollByTimeLogSink>("./Draft/logfile/test.txt", 20, false);
+    builder->buildType(logsys::LoggerType::LOGGER_ASYNC);
+    builder->buildSink<logsys::StdOutLogSink>();
+    builder->buildSink<logsys::FixedFileLogSink>("./Draft/logfile/test.txt");
+    builder->buildSink<logsys::RollBySizeLogSink>("./Draft/logfile/test.txt", 1024 * 1024, true, false);
+    builder->buildSink<logsys::RollByTimeLogSink>("./Draft/logfile/test.txt", 20, false);
     builder->buildFormat("test%%[test1][%T%d%{][%t][%p][%c][%f:%l] %m%n");
-    log::Logger::ptr logger = builder->build();
+    logsys::Logger::ptr logger = builder->build();
 
     // logger->debug(__FILE__, __LINE__,"{}{}", "־", 123);
     // logger->info(__FILE__, __LINE__,"{}{}", "־", 123);
@@ -65,5 +403,13 @@ int main()
     size_t cnt = 10000;
     while(cnt--)
     logger->fatal(__FILE__, __LINE__,"{}{}{}", cnt, ":־", 123);
-    return 0;
+    bool ok = checkAllocations();
+    ok = checkCompressedIndex() && ok;
+    ok = checkBinaryRoundTrip() && ok;
+    ok = checkRateLimit() && ok;
+    ok = checkCollapse() && ok;
+    ok = checkIoErrors() && ok;
+    ok = checkBackendPool() && ok;
+    ok = checkLogfmtKeys() && ok;
+    return ok ? 0 : 1;
 }
\ No newline at end of file
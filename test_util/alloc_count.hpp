@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+// 替换全局operator new，按线程统计内存分配次数，用于验证日志调用在稳定状态下不分配内存
+// 替换函数不能是inline的，因此该头文件只能被一个源文件包含
+namespace logsys::test_util
+{
+    inline thread_local size_t alloc_count = 0;
+    // 包装成类，防止不必要函数暴露
+    class AllocCount
+    {
+    public:
+        // 当前线程自创建以来的内存分配次数
+        AllocCount() : _begin(alloc_count) {}
+        size_t count() const { return alloc_count - _begin; }
+
+    private:
+        size_t _begin;
+    };
+
+    inline void *allocate(std::size_t size, std::size_t align = 0) noexcept
+    {
+        ++alloc_count;
+        if (size == 0) size = 1;
+        if (align <= alignof(std::max_align_t)) return std::malloc(size);
+        //aligned_alloc要求大小是对齐的整数倍
+        return std::aligned_alloc(align, (size + align - 1) / align * align);
+    }
+    // 不内联：否则GCC会把内联后的free与operator new配对，误报-Wmismatched-new-delete
+    [[gnu::noinline]] inline void release(void *p) noexcept { std::free(p); }
+}
+
+void *operator new(std::size_t size)
+{
+    if (void *p = logsys::test_util::allocate(size)) return p;
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t size) { return operator new(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return logsys::test_util::allocate(size); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return logsys::test_util::allocate(size); }
+void operator delete(void *p) noexcept { logsys::test_util::release(p); }
+void operator delete[](void *p) noexcept { logsys::test_util::release(p); }
+void operator delete(void *p, std::size_t) noexcept { logsys::test_util::release(p); }
+void operator delete[](void *p, std::size_t) noexcept { logsys::test_util::release(p); }
+// 对齐要求超过max_align_t的分配（alignas(64)的对象等）
+void *operator new(std::size_t size, std::align_val_t align)
+{
+    if (void *p = logsys::test_util::allocate(size, static_cast<std::size_t>(align))) return p;
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t size, std::align_val_t align) { return operator new(size, align); }
+void *operator new(std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept
+{
+    return logsys::test_util::allocate(size, static_cast<std::size_t>(align));
+}
+void *operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept
+{
+    return logsys::test_util::allocate(size, static_cast<std::size_t>(align));
+}
+void operator delete(void *p, std::align_val_t) noexcept { logsys::test_util::release(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { logsys::test_util::release(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { logsys::test_util::release(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { logsys::test_util::release(p); }
+
@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include "compress.hpp"
+#ifdef LOG_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace logsys::test_util
+{
+    // 解压CompressedFileLogSink写出的数据，可以是整个文件（多个帧首尾相连）或按索引截取的单个帧
+    class FrameDecode
+    {
+    public:
+        // 是否能够解压该类型，不能时相关检查应跳过
+        static bool supported(CompressType type)
+        {
+            if (type == CompressType::NONE) return true;
+#ifdef LOG_WITH_ZLIB
+            if (type == CompressType::GZIP) return true;
+#endif
+            return false;
+        }
+        static bool decode(CompressType type, const std::string &in, std::string &out)
+        {
+            out.clear();
+            if (type == CompressType::NONE)
+            {
+                out = in;
+                return true;
+            }
+#ifdef LOG_WITH_ZLIB
+            if (type == CompressType::GZIP) return gunzip(in, out);
+#endif
+            return false;
+        }
+
+    private:
+#ifdef LOG_WITH_ZLIB
+        // 逐个解压gzip成员
+        static bool gunzip(const std::string &in, std::string &out)
+        {
+            z_stream zs{};
+            if (inflateInit2(&zs, 15 + 16) != Z_OK) return false;
+            zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+            zs.avail_in = in.size();
+            char buf[4096];
+            int ret = Z_OK;
+            while (zs.avail_in > 0)
+            {
+                zs.next_out = reinterpret_cast<Bytef *>(buf);
+                zs.avail_out = sizeof(buf);
+                ret = inflate(&zs, Z_NO_FLUSH);
+                out.append(buf, sizeof(buf) - zs.avail_out);
+                if (ret == Z_STREAM_END) ret = inflateReset(&zs);
+                else if (ret != Z_OK) break;
+            }
+            inflateEnd(&zs);
+            return ret == Z_OK;
+        }
+#endif
+    };
+};
@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "binary.hpp"
+
+// 二进制日志解码工具：按给定的格式模式把BinaryFileLogSink写出的文件还原为文本，输出到标准输出
+// 用法：log_decode [-p pattern] [file...]，不指定文件时从标准输入读取
+static bool decodeStream(std::istream &in, const char *name, logsys::Format &format)
+{
+    const size_t CHUNK_SIZE = 1024 * 1024;
+    logsys::BinaryDecoder decoder;
+    std::string data, out;
+    size_t begin = 0;
+    try
+    {
+        while (in)
+        {
+            //未解码的不完整记录移到开头，与后续数据拼接
+            data.erase(0, begin);
+            begin = 0;
+            size_t size = data.size();
+            data.resize(size + CHUNK_SIZE);
+            in.read(data.data() + size, CHUNK_SIZE);
+            data.resize(size + in.gcount());
+            begin = decoder.render(data.data(), data.size(), format, out);
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            out.clear();
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "%s: %s\n", name, e.what());
+        return false;
+    }
+    if (begin != data.size())
+    {
+        std::fprintf(stderr, "%s: truncated record at end of file\n", name);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string pattern = "[%d{%H:%M:%S}][%t][%p][%c][%f:%l] %m%n";
+    std::vector<const char *> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-p") == 0 && i + 1 < argc) pattern = argv[++i];
+        else if (std::strcmp(argv[i], "-h") == 0 || std::strcmp(argv[i], "--help") == 0)
+        {
+            std::printf("usage: %s [-p pattern] [file...]\n", argv[0]);
+            return 0;
+        }
+        else files.push_back(argv[i]);
+    }
+    logsys::Format format(pattern);
+    bool ok = true;
+    if (files.empty()) ok = decodeStream(std::cin, "<stdin>", format);
+    for (const char *file : files)
+    {
+        std::ifstream ifs(file, std::ios::binary);
+        if (!ifs.is_open())
+        {
+            std::fprintf(stderr, "%s: cannot open file\n", file);
+            ok = false;
+            continue;
+        }
+        ok = decodeStream(ifs, file, format) && ok;
+    }
+    return ok ? 0 : 1;
+}
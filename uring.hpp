@@ -0,0 +1,270 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define LOG_HAS_IO_URING 1
+#endif
+
+// 异步文件写入引擎：提交写请求后立即返回，由调用者在需要时等待完成
+// 优先使用io_uring（直接通过系统调用，不依赖liburing），不可用时退化为pwrite线程池
+namespace logsys
+{
+    // 写请求，由调用者持有，完成前不能释放；_res与pwrite返回值含义相同，出错时为-errno
+    struct WriteRequest
+    {
+        const char *_data;
+        size_t _len;
+        off_t _offset;
+        ssize_t _res;
+        struct iovec _iov; // io_uring使用
+    };
+
+    class AsyncWriter
+    {
+    public:
+        using ptr = std::unique_ptr<AsyncWriter>;
+    public:
+        virtual ~AsyncWriter() {}
+        virtual void submit(WriteRequest *req) = 0;
+        // 阻塞直到有请求完成，返回该请求
+        virtual WriteRequest *wait() = 0;
+    };
+
+#ifdef LOG_HAS_IO_URING
+    class UringWriter : public AsyncWriter
+    {
+    public:
+        // 内核不支持或被禁止（如容器的seccomp策略）时返回空
+        static AsyncWriter::ptr create(int fd, unsigned depth)
+        {
+            std::unique_ptr<UringWriter> writer(new UringWriter(fd));
+            if (!writer->setup(depth)) return nullptr;
+            return writer;
+        }
+        ~UringWriter()
+        {
+            if (_sqes) munmap(_sqes, _sqes_len);
+            if (_cq_ptr && _cq_ptr != _sq_ptr) munmap(_cq_ptr, _cq_len);
+            if (_sq_ptr) munmap(_sq_ptr, _sq_len);
+            if (_ring_fd >= 0) ::close(_ring_fd);
+        }
+        void submit(WriteRequest *req) override
+        {
+            req->_iov.iov_base = const_cast<char *>(req->_data);
+            req->_iov.iov_len = req->_len;
+            unsigned tail = *_sq_tail;
+            unsigned idx = tail & *_sq_mask;
+            struct io_uring_sqe *sqe = &_sqes[idx];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_WRITEV;
+            sqe->fd = _fd;
+            sqe->addr = reinterpret_cast<uint64_t>(&req->_iov);
+            sqe->len = 1;
+            sqe->off = req->_offset;
+            sqe->user_data = reinterpret_cast<uint64_t>(req);
+            _sq_array[idx] = idx;
+            std::atomic_ref<unsigned>(*_sq_tail).store(tail + 1, std::memory_order_release);
+            ++_unsubmitted;
+            enterRing(0, 0);
+        }
+        WriteRequest *wait() override
+        {
+            while (true)
+            {
+                if (!_failed.empty())
+                {
+                    WriteRequest *req = _failed.front();
+                    _failed.pop_front();
+                    return req;
+                }
+                unsigned head = *_cq_head;
+                if (head != std::atomic_ref<unsigned>(*_cq_tail).load(std::memory_order_acquire))
+                {
+                    struct io_uring_cqe *cqe = &_cqes[head & *_cq_mask];
+                    WriteRequest *req = reinterpret_cast<WriteRequest *>(cqe->user_data);
+                    req->_res = cqe->res;
+                    std::atomic_ref<unsigned>(*_cq_head).store(head + 1, std::memory_order_release);
+                    return req;
+                }
+                enterRing(1, IORING_ENTER_GETEVENTS);
+            }
+        }
+
+    private:
+        UringWriter(int fd) : _fd(fd), _ring_fd(-1), _sq_ptr(nullptr), _cq_ptr(nullptr), _sqes(nullptr), _unsubmitted(0) {}
+        // 提交队列中尚未被内核取走的请求随每次调用一并提交；内核暂时无法接收（EAGAIN、EBUSY）时留在队列中，
+        // 由之后的submit或wait重试；其他错误下这些请求不会再被处理，撤回后以-errno作为结果由wait返回，
+        // 与写入失败的请求一样由使用者计数并报告
+        void enterRing(unsigned min_complete, unsigned flags)
+        {
+            while (true)
+            {
+                int ret = enter(_unsubmitted, min_complete, flags);
+                if (ret >= 0)
+                {
+                    _unsubmitted -= std::min<unsigned>(ret, _unsubmitted);
+                    return;
+                }
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EBUSY) return;
+                //出错时内核没有取走任何请求，未提交的请求位于队尾
+                int err = errno;
+                unsigned tail = *_sq_tail - _unsubmitted;
+                for (unsigned i = 0; i < _unsubmitted; ++i)
+                {
+                    WriteRequest *req = reinterpret_cast<WriteRequest *>(_sqes[(tail + i) & *_sq_mask].user_data);
+                    req->_res = -err;
+                    _failed.push_back(req);
+                }
+                std::atomic_ref<unsigned>(*_sq_tail).store(tail, std::memory_order_release);
+                _unsubmitted = 0;
+                return;
+            }
+        }
+        int enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+        {
+            return syscall(__NR_io_uring_enter, _ring_fd, to_submit, min_complete, flags, nullptr, 0);
+        }
+        bool setup(unsigned depth)
+        {
+            struct io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            _ring_fd = syscall(__NR_io_uring_setup, depth, &params);
+            if (_ring_fd < 0) return false;
+            _sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            _cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+            bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single) _sq_len = _cq_len = std::max(_sq_len, _cq_len);
+            void *ptr = mmap(nullptr, _sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+            if (ptr == MAP_FAILED) return false;
+            _sq_ptr = static_cast<char *>(ptr);
+            if (single) _cq_ptr = _sq_ptr;
+            else
+            {
+                ptr = mmap(nullptr, _cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_CQ_RING);
+                if (ptr == MAP_FAILED) return false;
+                _cq_ptr = static_cast<char *>(ptr);
+            }
+            _sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+            ptr = mmap(nullptr, _sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQES);
+            if (ptr == MAP_FAILED) return false;
+            _sqes = static_cast<struct io_uring_sqe *>(ptr);
+            _sq_tail = reinterpret_cast<unsigned *>(_sq_ptr + params.sq_off.tail);
+            _sq_mask = reinterpret_cast<unsigned *>(_sq_ptr + params.sq_off.ring_mask);
+            _sq_array = reinterpret_cast<unsigned *>(_sq_ptr + params.sq_off.array);
+            _cq_head = reinterpret_cast<unsigned *>(_cq_ptr + params.cq_off.head);
+            _cq_tail = reinterpret_cast<unsigned *>(_cq_ptr + params.cq_off.tail);
+            _cq_mask = reinterpret_cast<unsigned *>(_cq_ptr + params.cq_off.ring_mask);
+            _cqes = reinterpret_cast<struct io_uring_cqe *>(_cq_ptr + params.cq_off.cqes);
+            return true;
+        }
+
+    private:
+        int _fd;       // 写入的目标文件
+        int _ring_fd;
+        char *_sq_ptr;
+        size_t _sq_len;
+        char *_cq_ptr;
+        size_t _cq_len;
+        struct io_uring_sqe *_sqes;
+        size_t _sqes_len;
+        unsigned *_sq_tail;
+        unsigned *_sq_mask;
+        unsigned *_sq_array;
+        unsigned *_cq_head;
+        unsigned *_cq_tail;
+        unsigned *_cq_mask;
+        struct io_uring_cqe *_cqes;
+        unsigned _unsubmitted;               // 已放入提交队列但内核尚未取走的请求数
+        std::deque<WriteRequest *> _failed;  // 无法提交的请求，由wait优先返回
+    };
+#endif
+
+    // 退化实现：由若干线程执行pwrite
+    class PwritePool : public AsyncWriter
+    {
+    public:
+        PwritePool(int fd, size_t threads) : _fd(fd), _running(true)
+        {
+            for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+                _workers.emplace_back(&PwritePool::work, this);
+        }
+        ~PwritePool()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _running = false;
+            }
+            _task_cond.notify_all();
+            for (auto &worker : _workers) worker.join();
+        }
+        void submit(WriteRequest *req) override
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _tasks.push_back(req);
+            }
+            _task_cond.notify_one();
+        }
+        WriteRequest *wait() override
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _done_cond.wait(lock, [&](){return !_done.empty();});
+            WriteRequest *req = _done.front();
+            _done.pop_front();
+            return req;
+        }
+
+    private:
+        void work()
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            while (true)
+            {
+                _task_cond.wait(lock, [&](){return !_running || !_tasks.empty();});
+                if (_tasks.empty()) return;
+                WriteRequest *req = _tasks.front();
+                _tasks.pop_front();
+                lock.unlock();
+                ssize_t ret = ::pwrite(_fd, req->_data, req->_len, req->_offset);
+                req->_res = ret < 0 ? -errno : ret;
+                lock.lock();
+                _done.push_back(req);
+                _done_cond.notify_one();
+            }
+        }
+
+    private:
+        int _fd;
+        bool _running;
+        std::mutex _mtx;
+        std::condition_variable _task_cond;
+        std::condition_variable _done_cond;
+        std::deque<WriteRequest *> _tasks;
+        std::deque<WriteRequest *> _done;
+        std::vector<std::thread> _workers;
+    };
+
+    // depth为同时进行中的写请求上限
+    inline AsyncWriter::ptr createAsyncWriter(int fd, size_t depth)
+    {
+#ifdef LOG_HAS_IO_URING
+        if (auto writer = UringWriter::create(fd, depth)) return writer;
+#endif
+        return std::make_unique<PwritePool>(fd, depth);
+    }
+};
@@ -4,11 +4,65 @@
 #include <ctime>
 #include <sys/stat.h>
 #include <filesystem>
+#include <chrono>
+#if defined(LOG_USE_TSC) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
 
 namespace fs = std::filesystem;
 
-namespace log
+namespace logsys
 {
+    const int64_t NSEC_PER_SEC = 1000000000;
+#if defined(LOG_USE_TSC) && (defined(__x86_64__) || defined(__i386__))
+    // 基于TSC的时钟：读取时间戳计数器换算为纳秒，每个线程定期以系统时钟重新校准，避免频繁进入clock_gettime
+    class TscClock
+    {
+    public:
+        static int64_t nowNs()
+        {
+            thread_local Anchor anchor;
+            uint64_t tsc = __rdtsc();
+            if (anchor._base_tsc == 0)
+            {
+                anchor._base_tsc = tsc;
+                anchor._base_ns = systemNs();
+                return anchor._base_ns;
+            }
+            if (anchor._ns_per_tick == 0 || tsc - anchor._tsc > anchor._window)
+            {
+                int64_t ns = systemNs();
+                //基准间隔太短时换算比例误差较大，先直接使用系统时钟
+                if (ns - anchor._base_ns < CALIBRATE_MIN_NS) return ns;
+                //以线程首次取时间为基准计算比例，基准间隔越长越精确
+                anchor._ns_per_tick = (double)(ns - anchor._base_ns) / (tsc - anchor._base_tsc);
+                anchor._window = (uint64_t)(CALIBRATE_NS / anchor._ns_per_tick);
+                anchor._tsc = tsc;
+                anchor._ns = ns;
+                return ns;
+            }
+            return anchor._ns + (int64_t)((tsc - anchor._tsc) * anchor._ns_per_tick);
+        }
+
+    private:
+        static constexpr int64_t CALIBRATE_MIN_NS = 10000000;  // 开始使用TSC前的最短基准间隔
+        static constexpr int64_t CALIBRATE_NS = 100000000;     // 重新校准周期
+        struct Anchor
+        {
+            uint64_t _base_tsc = 0;
+            int64_t _base_ns = 0;
+            uint64_t _tsc = 0;
+            int64_t _ns = 0;
+            double _ns_per_tick = 0;
+            uint64_t _window = 0;
+        };
+        static int64_t systemNs()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+    };
+#endif
     class Date
     {
     public:
@@ -16,6 +70,16 @@ namespace log
         {
             return std::time(nullptr);
         }
+        // 纳秒精度的当前时间，定义LOG_USE_TSC时使用TSC时钟
+        static int64_t nowNs()
+        {
+#if defined(LOG_USE_TSC) && (defined(__x86_64__) || defined(__i386__))
+            return TscClock::nowNs();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+#endif
+        }
     };
     class File
     {